@@ -53,6 +53,7 @@ void show_help(char* argv[])
     fprintf(stderr, "Options and arguments:\n"
         "-i, --interactive : Enter a read-eval-print loop prompt after execution\n"
         "-c, --code        : Execute the provided Nominal source code as a string\n"
+        "-p, --profile     : Print the executed pairs of opcodes after execution\n"
         "-h, --help        : Display help text\n"
         "file              : Execute the provided Nominal source code file\n");
 }
@@ -117,6 +118,7 @@ bool parse_and_execute(NomState* state, int argc, char* argv[])
     assert(argv);
 
     bool interactive = false;
+    bool profile = false;
     for (int i = 1; i < argc; ++i)
     {
         if (strcmp(argv[i], "-h") == 0 ||
@@ -129,6 +131,11 @@ bool parse_and_execute(NomState* state, int argc, char* argv[])
         {
             interactive = true;
         }
+        else if (strcmp(argv[i], "-p") == 0 ||
+            strcmp(argv[i], "--profile") == 0)
+        {
+            profile = true;
+        }
         else if (strcmp(argv[i], "-c") == 0 ||
             strcmp(argv[i], "--code") == 0)
         {
@@ -175,6 +182,11 @@ bool parse_and_execute(NomState* state, int argc, char* argv[])
         repl(state);
     }
 
+    if (profile)
+    {
+        nom_dumpopcodepairs(state);
+    }
+
     return true;
 }
 
@@ -31,6 +31,7 @@
 #include "nominal/number.h"
 #include "nominal/map.h"
 #include "nominal/string.h"
+#include "nominal/bytes.h"
 #include "nominal/function.h"
 
 #endif
@@ -0,0 +1,87 @@
+///////////////////////////////////////////////////////////////////////////////
+// This source file is part of Nominal.
+//
+// Copyright (c) 2015 Colin Hill
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////
+/// \file
+///////////////////////////////////////////////////////////////////////////////
+#ifndef NOM_BYTES_H
+#define NOM_BYTES_H
+
+#include "nominal/export.h"
+#include "nominal/value.h"
+
+///
+/// \brief Checks if a value is a reference to a Nominal byte buffer.
+///
+/// \param state
+///     The state.
+/// \param value
+///     The value in question.
+///
+/// \returns True if the value is a reference to a Nominal byte buffer; false
+///          otherwise.
+NOM_EXPORT bool nom_isbytes(
+    NomState*   state,
+    NomValue    value
+);
+
+///
+/// \brief Creates a Nominal byte buffer referencing memory owned by the host
+///        without copying it.
+///
+/// \param state
+///     The state to create the value for.
+/// \param data
+///     The bytes.  The memory must remain valid and unchanged until it is
+///     released.
+/// \param length
+///     The number of bytes.
+/// \param release
+///     The function called with the bytes once the byte buffer is garbage
+///     collected; NULL if the bytes do not need to be released.
+///
+/// \returns A reference to the new Nominal byte buffer.
+NOM_EXPORT NomValue nom_newbytes(
+    NomState*           state,
+    const void*         data,
+    size_t              length,
+    NomReleaseFunction  release
+);
+
+///
+/// \brief Returns the bytes of a Nominal byte buffer.
+///
+/// \param state
+///     The state.
+/// \param value
+///     The byte buffer value.
+/// \param length
+///     Outputs the number of bytes.
+///
+/// \returns A pointer to the bytes; NULL if the value is not a byte buffer.
+NOM_EXPORT const void* nom_getbytes(
+    NomState*   state,
+    NomValue    value,
+    size_t*     length
+);
+
+#endif
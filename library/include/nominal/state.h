@@ -205,6 +205,19 @@ NOM_EXPORT void nom_dumpbytecode(
     NomState*   state
 );
 
+///
+/// \brief Prints how many times each pair of adjacent instructions
+///        was executed to stdout, most frequent first.
+///
+/// \note The counts are only gathered when Nominal is configured with
+///       NOM_OPCODE_PROFILE.
+///
+/// \param state
+///     The state.
+NOM_EXPORT void nom_dumpopcodepairs(
+    NomState*   state
+);
+
 NOM_EXPORT void nom_dumpstack(
     NomState*   state
 );
@@ -245,12 +258,12 @@ NOM_EXPORT const char* nom_geterror(
 );
 
 ///
-/// \brief Reclaims all unreferenced objects.
+/// \brief Reclaims all unreferenced objects and interned strings.
 ///
 /// \param state
 ///     The state.
 ///
-/// \returns The number of objects reclaimed.
+/// \returns The number of objects and interned strings reclaimed.
 NOM_EXPORT int nom_collectgarbage(
     NomState*   state
 );
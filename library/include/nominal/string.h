@@ -61,6 +61,9 @@ NOM_EXPORT NomValue nom_newstring(
 ///
 /// \brief Creates an interned Nominal string from a string.
 ///
+/// Interned strings are garbage collected like other values once they are no
+/// longer referenced (see nom_acquire()).
+///
 /// \param state
 ///     The state to create the value for.
 /// \param value
@@ -72,6 +75,30 @@ NOM_EXPORT NomValue nom_newinternedstring(
     const char* value
 );
 
+///
+/// \brief Creates a Nominal string referencing a string owned by the host
+///        without copying it.
+///
+/// \param state
+///     The state to create the value for.
+/// \param value
+///     The UTF-8 string value (does not need to be NULL-terminated).  The
+///     string must remain valid and unchanged until it is released.
+/// \param length
+///     The length of the string in bytes.
+/// \param release
+///     The function called with the string once the Nominal string no
+///     longer references it; NULL if the string does not need to be
+///     released.
+///
+/// \returns A reference to the new Nominal string.
+NOM_EXPORT NomValue nom_newexternalstring(
+    NomState*           state,
+    const char*         value,
+    size_t              length,
+    NomReleaseFunction  release
+);
+
 ///
 /// \brief Returns the value of a Nominal string as a string.
 ///
@@ -81,7 +108,8 @@ NOM_EXPORT NomValue nom_newinternedstring(
 ///     The string value.
 ///
 /// \returns A pointer to the UTF-8 NULL-terminated string; NULL if the value
-///          is not a string.
+///          is not a string.  The pointer is only valid until the next
+///          garbage collection.
 NOM_EXPORT const char* nom_getstring(
     NomState*   state,
     NomValue    value
@@ -51,6 +51,11 @@ typedef union
     } data;
 } NomValue;
 
+///
+/// \brief A function called to release host memory referenced by a Nominal
+///        value once the value no longer references it.
+typedef void (*NomReleaseFunction)(void* data);
+
 ///
 /// \brief An iterator for a Nominal value.
 typedef struct NomIterator
@@ -190,6 +195,8 @@ NOM_EXPORT size_t nom_tostring(
 ///
 /// \brief Adds another value to a Nominal value.
 ///
+/// Adding two strings results in the concatenation of the strings.
+///
 /// \param state
 ///     The state.
 /// \param left
@@ -439,6 +446,25 @@ NOM_EXPORT bool nom_set(
     NomValue    keyvalue
 );
 
+///
+/// \brief Removes the value for a key in a Nominal value.
+///
+/// \param state
+///     The state.
+/// \param value
+///     The value to remove from.
+/// \param key
+///     The key to remove the value for.
+///
+/// \returns True if the value was removed for the key; false if no value
+///          exists for the key or the value does not support removing values
+///          for keys.
+NOM_EXPORT bool nom_remove(
+    NomState*   state,
+    NomValue    value,
+    NomValue    key
+);
+
 ///
 /// \brief Acquires a reference to a Nominal value, assuring that the value
 ///        will not be garbage collected until after it is released.
@@ -0,0 +1,107 @@
+///////////////////////////////////////////////////////////////////////////////
+// This source file is part of Nominal.
+//
+// Copyright (c) 2015 Colin Hill
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////
+#include "arena.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+// Allocates a new chunk with room for at least the given size and makes it
+// the current chunk of the arena
+static ArenaChunk* newchunk(
+    Arena*  arena,
+    size_t  size
+);
+
+Arena* arena_new(
+    size_t  chunksize
+)
+{
+    Arena* arena = (Arena*)malloc(sizeof(Arena));
+    assert(arena);
+
+    arena->chunks = NULL;
+    arena->chunksize = chunksize;
+    return arena;
+}
+
+void arena_free(
+    Arena*  arena
+)
+{
+    assert(arena);
+
+    ArenaChunk* chunk = arena->chunks;
+    while (chunk)
+    {
+        ArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    free(arena);
+}
+
+void* arena_alloc(
+    Arena*  arena,
+    size_t  size
+)
+{
+    assert(arena);
+
+    // Keep every allocation aligned
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+    ArenaChunk* chunk = arena->chunks;
+    if (!chunk || chunk->size - chunk->used < size)
+    {
+        chunk = newchunk(arena, size);
+    }
+
+    void* data = &chunk->data[chunk->used];
+    chunk->used += size;
+    return data;
+}
+
+static ArenaChunk* newchunk(
+    Arena*  arena,
+    size_t  size
+)
+{
+    assert(arena);
+
+    // Allocations larger than a chunk get a chunk of their own
+    if (size < arena->chunksize)
+    {
+        size = arena->chunksize;
+    }
+
+    ArenaChunk* chunk = (ArenaChunk*)malloc(sizeof(ArenaChunk) + size);
+    assert(chunk);
+
+    chunk->next = arena->chunks;
+    chunk->size = size;
+    chunk->used = 0;
+    arena->chunks = chunk;
+    return chunk;
+}
@@ -0,0 +1,65 @@
+///////////////////////////////////////////////////////////////////////////////
+// This source file is part of Nominal.
+//
+// Copyright (c) 2015 Colin Hill
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_ALIGNMENT     (8)
+
+// A chunk of memory in an arena
+typedef struct ArenaChunk
+{
+    struct ArenaChunk*  next;
+    size_t              size;
+    size_t              used;
+    unsigned char       data[];
+} ArenaChunk;
+
+// An arena of memory which is allocated from sequentially and freed all at
+// once (allocations are never moved so pointers remain valid until the arena
+// is freed)
+typedef struct Arena
+{
+    ArenaChunk* chunks;
+    size_t      chunksize;
+} Arena;
+
+// Creates a new arena which allocates chunks of the given size (in bytes)
+Arena* arena_new(
+    size_t  chunksize
+);
+
+// Frees an arena and all memory allocated from it
+void arena_free(
+    Arena*  arena
+);
+
+// Allocates memory of the given size (in bytes) from an arena
+void* arena_alloc(
+    Arena*  arena,
+    size_t  size
+);
+
+#endif
@@ -0,0 +1,116 @@
+///////////////////////////////////////////////////////////////////////////////
+// This source file is part of Nominal.
+//
+// Copyright (c) 2015 Colin Hill
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////
+#include "heap.h"
+#include "state.h"
+#include "value.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+// The data of a byte buffer object on the heap
+typedef struct BytesData
+{
+    const void*         data;
+    size_t              length;
+    NomReleaseFunction  release;
+} BytesData;
+
+// Releases the bytes of a byte buffer object and frees the object
+static void freebytesdata(
+    void*   data
+);
+
+bool nom_isbytes(
+    NomState*   state,
+    NomValue    value
+)
+{
+    assert(state);
+
+    bool result = false;
+
+    HeapObject* object = heap_getobject(state->heap, value);
+    if (object)
+    {
+        result = object->type == OBJECTTYPE_BYTES;
+    }
+
+    return result;
+}
+
+NomValue nom_newbytes(
+    NomState*           state,
+    const void*         data,
+    size_t              length,
+    NomReleaseFunction  release
+)
+{
+    assert(state);
+    assert(data || length == 0);
+
+    NomValue bytes = heap_alloc(state->heap, OBJECTTYPE_BYTES, sizeof(BytesData), freebytesdata);
+
+    // Reference the bytes without copying them
+    BytesData* bytesdata = (BytesData*)heap_getdata(state->heap, bytes);
+    bytesdata->data = data;
+    bytesdata->length = length;
+    bytesdata->release = release;
+
+    return bytes;
+}
+
+const void* nom_getbytes(
+    NomState*   state,
+    NomValue    value,
+    size_t*     length
+)
+{
+    assert(state);
+    assert(length);
+
+    const void* data = NULL;
+
+    if (nom_isbytes(state, value))
+    {
+        BytesData* bytesdata = (BytesData*)heap_getdata(state->heap, value);
+        data = bytesdata->data;
+        *length = bytesdata->length;
+    }
+
+    return data;
+}
+
+static void freebytesdata(
+    void*   data
+)
+{
+    BytesData* bytesdata = (BytesData*)data;
+
+    if (bytesdata->release)
+    {
+        bytesdata->release((void*)bytesdata->data);
+    }
+
+    free(bytesdata);
+}
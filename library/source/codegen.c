@@ -23,17 +23,29 @@
 ///////////////////////////////////////////////////////////////////////////////
 #include "codegen.h"
 
-// Emits an opcode value to the byte code array
+#include <assert.h>
+#include <stdlib.h>
+
+// Emits an opcode to the byte code array
 #define OPCODE(op)\
-    bytecode[index++] = (unsigned char)op
+    bytecode[index++] = (uint32_t)op
+
+// Emits an operand to the byte code array
+#define OPERAND(v)\
+    bytecode[index++] = (uint32_t)(v)
 
-// Emits a raw value to the byte code array
-#define WRITEAS(t, v)\
-    *(t*)&bytecode[index] = v; index += sizeof(t)
+// Emits an operand referencing a constant in the constant pool
+#define CONSTANT(v)\
+    bytecode[index++] = addconstant(constants, v)
+
+// The size (in words) of the buffer used to swap ranges of byte code without
+// allocating
+#define SWAP_BUFFER_SIZE    (64)
 
 uint32_t generatecode(
     Node*           node,
-    unsigned char*  bytecode,
+    uint32_t*       bytecode,
+    ConstantPool*   constants,
     uint32_t        index
 )
 {
@@ -41,11 +53,11 @@ uint32_t generatecode(
     {
     case NODE_NUMBER:
         OPCODE(OPCODE_PUSH);
-        WRITEAS(NomValue, nom_fromdouble(node->data.number.value));
+        CONSTANT(nom_fromdouble(node->data.number.value));
         break;
     case NODE_STRING:
         OPCODE(OPCODE_PUSH);
-        WRITEAS(NomValue, string_newinterned(node->data.string.id));
+        CONSTANT(string_newinterned(node->data.string.id));
         break;
     case NODE_MAP:
     {
@@ -65,11 +77,11 @@ uint32_t generatecode(
             {
                 // Value on stack
                 Node* rightexpr = assoc->data.binary.rightexpr;
-                index = generatecode(rightexpr, bytecode, index);
+                index = generatecode(rightexpr, bytecode, constants, index);
 
                 // Key on stack
                 Node* leftexpr = assoc->data.binary.leftexpr;
-                index = generatecode(leftexpr, bytecode, index);
+                index = generatecode(leftexpr, bytecode, constants, index);
 
                 node = node->data.map.prev;
                 ++itemcount;
@@ -83,25 +95,28 @@ uint32_t generatecode(
 
         // Create the map
         OPCODE(OPCODE_MAP);
-        WRITEAS(uint32_t, itemcount);
+        OPERAND(itemcount);
     }
     break;
     case NODE_IDENT:
         OPCODE(OPCODE_FETCH);
-        WRITEAS(StringId, node->data.ident.id);
+        OPERAND(node->data.ident.id);
         break;
     case NODE_UNARY:
-        index = generatecode(node->data.unary.expr, bytecode, index);
-        OPCODE(OP_OPCODE[node->data.unary.op]);
-        break;
+    {
+        uint32_t start = index;
+        index = generatecode(node->data.unary.expr, bytecode, constants, index);
+        index = emitoperation(bytecode, constants, start, index, OP_OPCODE[node->data.unary.op]);
+    }
+    break;
     case NODE_INDEX:
-        index = generatecode(node->data.index.expr, bytecode, index);
+        index = generatecode(node->data.index.expr, bytecode, constants, index);
         if (node->data.index.class)
         {
             OPCODE(OPCODE_CLASSOF);
         }
 
-        index = generatecode(node->data.index.key, bytecode, index);
+        index = generatecode(node->data.index.key, bytecode, constants, index);
         if (node->data.index.bracket)
         {
             OPCODE(OPCODE_GET);
@@ -110,6 +125,7 @@ uint32_t generatecode(
         {
             OPCODE(OPCODE_FIND);
         }
+        OPERAND(INLINE_CACHE_NONE); // Allocated on first execution
         break;
     case NODE_BINARY:
     {
@@ -121,39 +137,55 @@ uint32_t generatecode(
         // And/or operations require short-circuit logic
         if (op == OP_OR || op == OP_AND)
         {
-            index = generatecode(leftexpr, bytecode, index);
+            uint32_t start = index;
+            index = generatecode(leftexpr, bytecode, constants, index);
+
+            // If the left expression is a constant then the operation either
+            // always short-circuits to the constant or always results in the
+            // truth of the right expression
+            NomValue constant;
+            if (readconstant(bytecode, constants, start, index, &constant))
+            {
+                if (constantistrue(constant) != (op == OP_OR))
+                {
+                    index = generatecode(rightexpr, bytecode, constants, start);
+                    index = emitoperation(bytecode, constants, start, index, OPCODE_NOT);
+                    index = emitoperation(bytecode, constants, start, index, OPCODE_NOT);
+                }
+                break;
+            }
 
             // Skip past the right expression if short-circuited
             OPCODE(OPCODE_DUP);
-            WRITEAS(uint32_t, 0);
+            OPERAND(0);
             if (op == OP_AND)
             {
                 OPCODE(OPCODE_NOT);
             }
             OPCODE(OPCODE_JUMPIF);
             uint32_t gotoindex = index;
-            WRITEAS(uint32_t, 0);
+            OPERAND(0);
 
-            index = generatecode(rightexpr, bytecode, index);
+            index = generatecode(rightexpr, bytecode, constants, index);
             OPCODE(OP_OPCODE[op]);
 
             uint32_t endindex = index;
             index = gotoindex;
-            WRITEAS(uint32_t, endindex);
+            OPERAND(endindex);
             index = endindex;
         }
         else if (op == OP_DEFINE || op == OP_ASSIGN)
         {
-            index = generatecode(rightexpr, bytecode, index);
+            index = generatecode(rightexpr, bytecode, constants, index);
             if (leftexpr->type == NODE_INDEX)
             {
-                index = generatecode(leftexpr->data.index.expr, bytecode, index);
+                index = generatecode(leftexpr->data.index.expr, bytecode, constants, index);
                 if (leftexpr->data.index.class)
                 {
                     OPCODE(OPCODE_CLASSOF);
                 }
 
-                index = generatecode(leftexpr->data.index.key, bytecode, index);
+                index = generatecode(leftexpr->data.index.key, bytecode, constants, index);
 
                 if (op == OP_ASSIGN)
                 {
@@ -176,14 +208,15 @@ uint32_t generatecode(
             {
                 // Perform set
                 OPCODE(OP_OPCODE[op]);
-                WRITEAS(StringId, leftexpr->data.ident.id);
+                OPERAND(leftexpr->data.ident.id);
             }
         }
         else
         {
-            index = generatecode(rightexpr, bytecode, index);
-            index = generatecode(leftexpr, bytecode, index);
-            OPCODE(OP_OPCODE[op]);
+            uint32_t start = index;
+            index = generatecode(rightexpr, bytecode, constants, index);
+            index = generatecode(leftexpr, bytecode, constants, index);
+            index = emitoperation(bytecode, constants, start, index, OP_OPCODE[op]);
         }
     }
     break;
@@ -191,7 +224,7 @@ uint32_t generatecode(
     {
         while (node)
         {
-            index = generatecode(node->data.sequence.expr, bytecode, index);
+            index = generatecode(node->data.sequence.expr, bytecode, constants, index);
             node = node->data.sequence.next;
 
             // Pop the result of that expression off of the stack if there is
@@ -208,13 +241,13 @@ uint32_t generatecode(
         // Go to the end of the function body
         OPCODE(OPCODE_JUMP);
         uint32_t gotoindex = index;
-        WRITEAS(uint32_t, 0); // This will be known once the function code is generated
+        OPERAND(0); // This will be known once the function code is generated
 
         // Remember the instruction pointer where the function begins
         uint32_t ip = index;
 
         // Generate the code for the function body
-        index = generatecode(node->data.function.exprs, bytecode, index);
+        index = generatecode(node->data.function.exprs, bytecode, constants, index);
         OPCODE(OPCODE_RET);
 
         // Remember the instruction pointer where the function ends
@@ -222,14 +255,14 @@ uint32_t generatecode(
 
         // Re-write the goto instruction pointer
         index = gotoindex;
-        WRITEAS(uint32_t, endindex);
+        OPERAND(endindex);
         index = endindex;
 
         // Create the function
         OPCODE(OPCODE_FUNCTION);
-        WRITEAS(uint32_t, ip);
+        OPERAND(ip);
         uint32_t paramcountindex = index;
-        WRITEAS(uint32_t, 0); // This will be known once the parameters are traversed
+        OPERAND(0); // This will be known once the parameters are traversed
 
         uint32_t paramcount = 0;
 
@@ -240,7 +273,7 @@ uint32_t generatecode(
             Node* paramexpr = param->data.sequence.expr;
             if (paramexpr)
             {
-                WRITEAS(StringId, paramexpr->data.string.id);
+                OPERAND(paramexpr->data.string.id);
                 param = param->data.sequence.next;
                 ++paramcount;
             }
@@ -255,7 +288,7 @@ uint32_t generatecode(
 
         // Re-write the parameter count
         index = paramcountindex;
-        WRITEAS(uint32_t, paramcount);
+        OPERAND(paramcount);
         index = endindex;
     }
     break;
@@ -270,7 +303,7 @@ uint32_t generatecode(
         // Push the object as the first argument
         if (class)
         {
-            index = generatecode(expr->data.index.expr, bytecode, index);
+            index = generatecode(expr->data.index.expr, bytecode, constants, index);
             ++argcount;
         }
 
@@ -282,7 +315,7 @@ uint32_t generatecode(
             if (argExpr)
             {
                 // Generate the code to push the argument on the stack
-                index = generatecode(argExpr, bytecode, index);
+                index = generatecode(argExpr, bytecode, constants, index);
                 arg = arg->data.sequence.next;
                 ++argcount;
             }
@@ -294,24 +327,20 @@ uint32_t generatecode(
 
         if (class)
         {
-            // Get the class of the object
-            OPCODE(OPCODE_DUP);
-            WRITEAS(uint32_t, argcount - 1);
-            OPCODE(OPCODE_CLASSOF);
-
-            index = generatecode(expr->data.index.key, bytecode, index);
-            OPCODE(OPCODE_FIND);
+            // Look up the method in the class of the object and call it
+            OPCODE(OPCODE_CALL_METHOD);
+            OPERAND(expr->data.index.key->data.string.id);
         }
         else
         {
             // Generate the code to push the function on the stack
-            index = generatecode(node->data.invocation.expr, bytecode, index);
-        }
+            index = generatecode(node->data.invocation.expr, bytecode, constants, index);
 
-        // Call the function
-        OPCODE(OPCODE_CALL);
+            // Call the function
+            OPCODE(OPCODE_CALL);
+        }
 
-        WRITEAS(uint32_t, argcount);
+        OPERAND(argcount);
     }
     break;
     }
@@ -319,6 +348,318 @@ uint32_t generatecode(
     return index;
 }
 
+uint32_t emitoperation(
+    uint32_t*       bytecode,
+    ConstantPool*   constants,
+    uint32_t        start,
+    uint32_t        index,
+    OpCode          op
+)
+{
+    NomValue result = nom_nil();
+    bool folded = false;
+
+    NomValue value;
+    if (op == OPCODE_NEG || op == OPCODE_NOT)
+    {
+        if (readconstant(bytecode, constants, start, index, &value))
+        {
+            if (op == OPCODE_NOT)
+            {
+                result = constantistrue(value) ? nom_false() : nom_true();
+                folded = true;
+            }
+            else if (IS_NUMBER(value))
+            {
+                result.number = -value.number;
+                folded = true;
+            }
+        }
+    }
+    else
+    {
+        // The right operand is pushed before the left operand
+        uint32_t middle = start + instructionlength(bytecode, start);
+
+        NomValue l;
+        NomValue r;
+        if (middle < index &&
+                readconstant(bytecode, constants, start, middle, &r) &&
+                readconstant(bytecode, constants, middle, index, &l) &&
+                IS_NUMBER(l) && IS_NUMBER(r))
+        {
+            folded = true;
+            switch (op)
+            {
+            case OPCODE_ADD:
+                result.number = l.number + r.number;
+                break;
+            case OPCODE_SUB:
+                result.number = l.number - r.number;
+                break;
+            case OPCODE_MUL:
+                result.number = l.number * r.number;
+                break;
+            case OPCODE_DIV:
+                result.number = l.number / r.number;
+                break;
+            case OPCODE_EQ:
+                result = l.number == r.number ? nom_true() : nom_false();
+                break;
+            case OPCODE_NE:
+                result = l.number != r.number ? nom_true() : nom_false();
+                break;
+            case OPCODE_GT:
+                result = l.number > r.number ? nom_true() : nom_false();
+                break;
+            case OPCODE_GTE:
+                result = l.number >= r.number ? nom_true() : nom_false();
+                break;
+            case OPCODE_LT:
+                result = l.number < r.number ? nom_true() : nom_false();
+                break;
+            case OPCODE_LTE:
+                result = l.number <= r.number ? nom_true() : nom_false();
+                break;
+            default:
+                folded = false;
+                break;
+            }
+        }
+    }
+
+    if (folded)
+    {
+        // Replace the operands with the result
+        index = start;
+        OPCODE(OPCODE_PUSH);
+        CONSTANT(result);
+    }
+    else
+    {
+        OPCODE(op);
+    }
+
+    return index;
+}
+
+bool readconstant(
+    const uint32_t*         bytecode,
+    const ConstantPool*     constants,
+    uint32_t                start,
+    uint32_t                index,
+    NomValue*               value
+)
+{
+    if (index - start != 2 || bytecode[start] != OPCODE_PUSH)
+    {
+        return false;
+    }
+
+    *value = constants->values[bytecode[start + 1]];
+    return true;
+}
+
+uint32_t addconstant(
+    ConstantPool*   constants,
+    NomValue        value
+)
+{
+    assert(constants);
+
+    for (uint32_t i = 0; i < constants->count; ++i)
+    {
+        if (constants->values[i].raw == value.raw)
+        {
+            return i;
+        }
+    }
+
+    if (constants->count >= constants->capacity)
+    {
+        uint32_t capacity = constants->capacity == 0 ? 64 : constants->capacity * 2;
+        NomValue* values = (NomValue*)realloc(constants->values, sizeof(NomValue) * capacity);
+        assert(values);
+
+        constants->values = values;
+        constants->capacity = capacity;
+    }
+
+    constants->values[constants->count] = value;
+    return constants->count++;
+}
+
+bool constantistrue(
+    NomValue    value
+)
+{
+    if (GET_TYPE(value) == VALUETYPE_BOOLEAN)
+    {
+        return GET_ID(value) == 1;
+    }
+    else
+    {
+        return !nom_isnil(value);
+    }
+}
+
+uint32_t instructionlength(
+    const uint32_t*         bytecode,
+    uint32_t                index
+)
+{
+    switch ((OpCode)bytecode[index])
+    {
+    case OPCODE_PUSH:
+        return 2;
+    case OPCODE_DEFINE:
+    case OPCODE_ASSIGN:
+    case OPCODE_FETCH:
+    case OPCODE_DEFINE_DROP:
+    case OPCODE_ASSIGN_DROP:
+    case OPCODE_FETCH_ADD:
+    case OPCODE_FETCH_SUB:
+    case OPCODE_FETCH_LT:
+    case OPCODE_FETCH_LTE:
+    case OPCODE_FETCH_ADD_NUM:
+    case OPCODE_FETCH_SUB_NUM:
+    case OPCODE_FETCH_LT_NUM:
+    case OPCODE_FETCH_LTE_NUM:
+        return 2;
+    case OPCODE_DUP:
+    case OPCODE_FIND:
+    case OPCODE_GET:
+    case OPCODE_MAP:
+    case OPCODE_JUMP:
+    case OPCODE_JUMPIF:
+    case OPCODE_JUMPIF_KEEP:
+    case OPCODE_JUMPIFNOT_KEEP:
+    case OPCODE_JUMPIF_EQ:
+    case OPCODE_JUMPIFNOT_EQ:
+    case OPCODE_JUMPIF_NE:
+    case OPCODE_JUMPIFNOT_NE:
+    case OPCODE_JUMPIF_GT:
+    case OPCODE_JUMPIFNOT_GT:
+    case OPCODE_JUMPIF_GTE:
+    case OPCODE_JUMPIFNOT_GTE:
+    case OPCODE_JUMPIF_LT:
+    case OPCODE_JUMPIFNOT_LT:
+    case OPCODE_JUMPIF_LTE:
+    case OPCODE_JUMPIFNOT_LTE:
+    case OPCODE_CALL:
+    case OPCODE_SLIDE:
+        return 2;
+    case OPCODE_CALL_METHOD:
+    case OPCODE_FETCH_CALL:
+    case OPCODE_INLINE:
+    case OPCODE_GUARD_NUM:
+        return 3;
+    case OPCODE_PUSH_FETCH:
+        return 3;
+    case OPCODE_PUSH_FIND:
+        return 3;
+    case OPCODE_FETCH_FETCH:
+        return 3;
+    case OPCODE_FUNCTION:
+    {
+        uint32_t paramcount = bytecode[index + 2];
+        return 3 + paramcount;
+    }
+    default:
+        return 1;
+    }
+}
+
+void relocatecode(
+    uint32_t*       bytecode,
+    uint32_t        start,
+    uint32_t        end,
+    int32_t         offset
+)
+{
+    uint32_t index = start;
+    while (index < end)
+    {
+        switch ((OpCode)bytecode[index])
+        {
+        case OPCODE_JUMP:
+        case OPCODE_JUMPIF:
+        case OPCODE_JUMPIF_KEEP:
+        case OPCODE_JUMPIFNOT_KEEP:
+        case OPCODE_JUMPIF_EQ:
+        case OPCODE_JUMPIFNOT_EQ:
+        case OPCODE_JUMPIF_NE:
+        case OPCODE_JUMPIFNOT_NE:
+        case OPCODE_JUMPIF_GT:
+        case OPCODE_JUMPIFNOT_GT:
+        case OPCODE_JUMPIF_GTE:
+        case OPCODE_JUMPIFNOT_GTE:
+        case OPCODE_JUMPIF_LT:
+        case OPCODE_JUMPIFNOT_LT:
+        case OPCODE_JUMPIF_LTE:
+        case OPCODE_JUMPIFNOT_LTE:
+        case OPCODE_FUNCTION:
+            bytecode[index + 1] += offset;
+            break;
+        case OPCODE_INLINE:
+        {
+            // The inlined function is usually defined before the code being
+            // moved, in which case its entry stays where it is
+            int64_t entry = (int64_t)bytecode[index + 1];
+            if (entry >= (int64_t)start - offset && entry < (int64_t)end - offset)
+            {
+                bytecode[index + 1] += offset;
+            }
+            bytecode[index + 2] += offset;
+        }
+        break;
+        case OPCODE_GUARD_NUM:
+            bytecode[index + 2] += offset;
+            break;
+        default:
+            break;
+        }
+
+        index += instructionlength(bytecode, index);
+    }
+}
+
+void swapcode(
+    uint32_t*       bytecode,
+    uint32_t        start,
+    uint32_t        middle,
+    uint32_t        end
+)
+{
+    uint32_t firstlength = middle - start;
+    uint32_t secondlength = end - middle;
+    if (firstlength == 0 || secondlength == 0)
+    {
+        return;
+    }
+
+    uint32_t stackbuffer[SWAP_BUFFER_SIZE];
+    uint32_t* buffer = stackbuffer;
+    if (firstlength > SWAP_BUFFER_SIZE)
+    {
+        buffer = (uint32_t*)malloc(firstlength * sizeof(uint32_t));
+        assert(buffer);
+    }
+
+    // Move the second range to the start and the first range after it
+    memcpy(buffer, &bytecode[start], firstlength * sizeof(uint32_t));
+    memmove(&bytecode[start], &bytecode[middle], secondlength * sizeof(uint32_t));
+    memcpy(&bytecode[start + secondlength], buffer, firstlength * sizeof(uint32_t));
+
+    if (buffer != stackbuffer)
+    {
+        free(buffer);
+    }
+
+    relocatecode(bytecode, start, start + secondlength, -(int32_t)firstlength);
+    relocatecode(bytecode, start + secondlength, end, (int32_t)secondlength);
+}
+
 const OpCode OP_OPCODE[] =
 {
     OPCODE_DEFINE,  // OP_DEFINE
@@ -363,6 +704,8 @@ const char* const OPCODE_NAMES[] =
     "DEFINE",       // OPCODE_DEFINE
     "ASSIGN",       // OPCODE_ASSIGN
     "FETCH",        // OPCODE_FETCH
+    "DEFINE_DROP",  // OPCODE_DEFINE_DROP
+    "ASSIGN_DROP",  // OPCODE_ASSIGN_DROP
     "INSERT",       // OPCODE_INSERT
     "UPDATE",       // OPCODE_UPDATE
     "FIND",         // OPCODE_FIND
@@ -373,6 +716,44 @@ const char* const OPCODE_NAMES[] =
     "CLASSOF",      // OPCODE_CLASSOF
     "JUMP",         // OPCODE_JUMP
     "JUMPIF",       // OPCODE_JUMPIF
+    "JUMPIF_KEEP",  // OPCODE_JUMPIF_KEEP
+    "JUMPIFNOT_KEEP", // OPCODE_JUMPIFNOT_KEEP
+    "JUMPIF_EQ",    // OPCODE_JUMPIF_EQ
+    "JUMPIFNOT_EQ", // OPCODE_JUMPIFNOT_EQ
+    "JUMPIF_NE",    // OPCODE_JUMPIF_NE
+    "JUMPIFNOT_NE", // OPCODE_JUMPIFNOT_NE
+    "JUMPIF_GT",    // OPCODE_JUMPIF_GT
+    "JUMPIFNOT_GT", // OPCODE_JUMPIFNOT_GT
+    "JUMPIF_GTE",   // OPCODE_JUMPIF_GTE
+    "JUMPIFNOT_GTE", // OPCODE_JUMPIFNOT_GTE
+    "JUMPIF_LT",    // OPCODE_JUMPIF_LT
+    "JUMPIFNOT_LT", // OPCODE_JUMPIFNOT_LT
+    "JUMPIF_LTE",   // OPCODE_JUMPIF_LTE
+    "JUMPIFNOT_LTE", // OPCODE_JUMPIFNOT_LTE
     "CALL",         // OPCODE_CALL
-    "RET"           // OPCODE_RET
+    "CALL_METHOD",  // OPCODE_CALL_METHOD
+    "RET",          // OPCODE_RET
+    "INLINE",       // OPCODE_INLINE
+    "GUARD_NUM",    // OPCODE_GUARD_NUM
+    "SLIDE",        // OPCODE_SLIDE
+    "PUSH_FETCH",   // OPCODE_PUSH_FETCH
+    "PUSH_FIND",    // OPCODE_PUSH_FIND
+    "FETCH_FETCH",  // OPCODE_FETCH_FETCH
+    "FETCH_CALL",   // OPCODE_FETCH_CALL
+    "FETCH_ADD",    // OPCODE_FETCH_ADD
+    "FETCH_SUB",    // OPCODE_FETCH_SUB
+    "FETCH_LT",     // OPCODE_FETCH_LT
+    "FETCH_LTE",    // OPCODE_FETCH_LTE
+    "ADD_NUM",      // OPCODE_ADD_NUM
+    "SUB_NUM",      // OPCODE_SUB_NUM
+    "MUL_NUM",      // OPCODE_MUL_NUM
+    "DIV_NUM",      // OPCODE_DIV_NUM
+    "GT_NUM",       // OPCODE_GT_NUM
+    "GTE_NUM",      // OPCODE_GTE_NUM
+    "LT_NUM",       // OPCODE_LT_NUM
+    "LTE_NUM",      // OPCODE_LTE_NUM
+    "FETCH_ADD_NUM", // OPCODE_FETCH_ADD_NUM
+    "FETCH_SUB_NUM", // OPCODE_FETCH_SUB_NUM
+    "FETCH_LT_NUM", // OPCODE_FETCH_LT_NUM
+    "FETCH_LTE_NUM" // OPCODE_FETCH_LTE_NUM
 };
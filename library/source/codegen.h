@@ -28,6 +28,7 @@
 #include "state.h"
 #include "string.h"
 #include "stringpool.h"
+#include "value.h"
 
 #include <nominal.h>
 #include <string.h>
@@ -64,6 +65,8 @@ typedef enum
     OPCODE_DEFINE,
     OPCODE_ASSIGN,
     OPCODE_FETCH,
+    OPCODE_DEFINE_DROP,
+    OPCODE_ASSIGN_DROP,
 
     // Value operations
     OPCODE_INSERT,
@@ -80,9 +83,66 @@ typedef enum
     // Flow operations
     OPCODE_JUMP,
     OPCODE_JUMPIF,
+    OPCODE_JUMPIF_KEEP,
+    OPCODE_JUMPIFNOT_KEEP,
+
+    // Comparisons fused with a conditional jump on their result (the result
+    // is left on the stack like JUMPIF_KEEP/JUMPIFNOT_KEEP)
+    OPCODE_JUMPIF_EQ,
+    OPCODE_JUMPIFNOT_EQ,
+    OPCODE_JUMPIF_NE,
+    OPCODE_JUMPIFNOT_NE,
+    OPCODE_JUMPIF_GT,
+    OPCODE_JUMPIFNOT_GT,
+    OPCODE_JUMPIF_GTE,
+    OPCODE_JUMPIFNOT_GTE,
+    OPCODE_JUMPIF_LT,
+    OPCODE_JUMPIFNOT_LT,
+    OPCODE_JUMPIF_LTE,
+    OPCODE_JUMPIFNOT_LTE,
+
     OPCODE_CALL,
+    OPCODE_CALL_METHOD,
     OPCODE_RET,
 
+    // Inlined calls (a call to a small function literal is compiled to a copy
+    // of its body, guarded by the function being called and by arithmetic
+    // operations only seeing numbers, followed by the call itself for when a
+    // guard fails)
+    OPCODE_INLINE,
+    OPCODE_GUARD_NUM,
+    OPCODE_SLIDE,
+
+    // Superinstructions (pairs of adjacent instructions executed as one,
+    // taking the operands of both)
+    OPCODE_PUSH_FETCH,
+    OPCODE_PUSH_FIND,
+    OPCODE_FETCH_FETCH,
+    OPCODE_FETCH_CALL,
+    OPCODE_FETCH_ADD,
+    OPCODE_FETCH_SUB,
+    OPCODE_FETCH_LT,
+    OPCODE_FETCH_LTE,
+
+    // Quickened operations (an arithmetic or comparison instruction is
+    // rewritten in place to its quickened form once it sees two numbers, and
+    // back to its generic form if it later sees anything else)
+    OPCODE_ADD_NUM,
+    OPCODE_SUB_NUM,
+    OPCODE_MUL_NUM,
+    OPCODE_DIV_NUM,
+    OPCODE_GT_NUM,
+    OPCODE_GTE_NUM,
+    OPCODE_LT_NUM,
+    OPCODE_LTE_NUM,
+    OPCODE_FETCH_ADD_NUM,
+    OPCODE_FETCH_SUB_NUM,
+    OPCODE_FETCH_LT_NUM,
+    OPCODE_FETCH_LTE_NUM,
+
+    // The number of byte code operations
+    OPCODE_COUNT,
+
     OPCODE_INVALID = 0xFF
 } OpCode;
 
@@ -96,8 +156,67 @@ extern const char* const OPCODE_NAMES[];
 // byte code ends
 uint32_t generatecode(
     Node*           node,
-    unsigned char*  bytecode,
+    uint32_t*       bytecode,
+    ConstantPool*   constants,
     uint32_t        index
 );
 
+// Adds a constant to a constant pool (or finds the identical constant already
+// in the pool) and returns its index
+uint32_t addconstant(
+    ConstantPool*   constants,
+    NomValue        value
+);
+
+// Emits an operation on the values pushed by the byte code from start to
+// index, folding the operation and its operands into a single constant if the
+// operands are constants, and returns the index where the byte code ends
+uint32_t emitoperation(
+    uint32_t*       bytecode,
+    ConstantPool*   constants,
+    uint32_t        start,
+    uint32_t        index,
+    OpCode          op
+);
+
+// Returns whether the byte code from start to index pushes a single constant,
+// reading the constant if so
+bool readconstant(
+    const uint32_t*         bytecode,
+    const ConstantPool*     constants,
+    uint32_t                start,
+    uint32_t                index,
+    NomValue*               value
+);
+
+// Returns whether a constant is considered true
+bool constantistrue(
+    NomValue    value
+);
+
+// Returns the length (in words) of the instruction at an index including its
+// operands
+uint32_t instructionlength(
+    const uint32_t*         bytecode,
+    uint32_t                index
+);
+
+// Adds an offset to the absolute instruction pointers referenced by the
+// instructions in a range of byte code (needed once the code is moved)
+void relocatecode(
+    uint32_t*       bytecode,
+    uint32_t        start,
+    uint32_t        end,
+    int32_t         offset
+);
+
+// Swaps two adjacent ranges of byte code (from start to middle and from
+// middle to end), relocating the instructions in both
+void swapcode(
+    uint32_t*       bytecode,
+    uint32_t        start,
+    uint32_t        middle,
+    uint32_t        end
+);
+
 #endif
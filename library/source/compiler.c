@@ -0,0 +1,1240 @@
+///////////////////////////////////////////////////////////////////////////////
+// This source file is part of Nominal.
+//
+// Copyright (c) 2015 Colin Hill
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////
+#include "compiler.h"
+#include "codegen.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+// The maximum length (in words) of the body of a function literal which calls
+// are inlined into
+#define COMPILER_MAX_INLINE_LENGTH      (32)
+
+// The maximum number of function literals which calls can be inlined into at
+// once
+#define COMPILER_MAX_INLINE_FUNCTIONS   (16)
+
+// Emits an opcode to the byte code array
+#define OPCODE(op)\
+    compiler->bytecode[compiler->index++] = (uint32_t)op
+
+// Emits an operand to the byte code array
+#define OPERAND(v)\
+    compiler->bytecode[compiler->index++] = (uint32_t)(v)
+
+// Emits an operand referencing a constant in the constant pool
+#define CONSTANT(v)\
+    compiler->bytecode[compiler->index++] = addconstant(compiler->constants, v)
+
+// The kind of code emitted for an expression
+typedef enum
+{
+    EXPR_VALUE,
+    EXPR_IDENT,
+    EXPR_INDEX
+} ExprKind;
+
+// Describes the code emitted for an expression (the code of identifiers and
+// indices is rewritten when they turn out to be the left side of an
+// assignment, the callee of a method invocation, or the key of a map item)
+typedef struct Expr
+{
+    ExprKind    kind;
+    uint32_t    start;      // Where the code of the expression starts
+    uint32_t    keystart;   // Where the code following the indexed expression starts
+    uint32_t    opindex;    // Where the FIND/GET instruction of an index starts
+    StringId    id;         // The identifier or the key of a dot index
+    bool        bracket;
+    bool        class;
+    bool        item;       // Whether the expression is a complete map item
+} Expr;
+
+// A function literal assigned to a variable by a statement of a sequence
+// being compiled, which calls to the variable are inlined into
+typedef struct InlineFunction
+{
+    StringId    id;
+    uint32_t    function;   // Where the FUNCTION instruction creating it starts
+} InlineFunction;
+
+// A single-pass compiler
+typedef struct Compiler
+{
+    Parser*         parser;
+    Lexer*          lexer;
+    uint32_t*       bytecode;
+    ConstantPool*   constants;
+    uint32_t        index;
+
+    // Whether a construct which is only supported when compiling through the
+    // AST was encountered
+    bool            unsupported;
+
+    // The function literals which calls can be inlined into (only those
+    // defined by the sequences currently being compiled, since the code of a
+    // completed statement does not move until its sequence is complete)
+    InlineFunction  inlinefunctions[COMPILER_MAX_INLINE_FUNCTIONS];
+    uint32_t        inlinefunctioncount;
+} Compiler;
+
+// Compiles a sequence of expressions
+static bool compileexprs(
+    Compiler*   compiler,
+    bool        newlines
+);
+
+// Compiles an expression (as an item of a map literal if specified)
+static bool compileexpr(
+    Compiler*   compiler,
+    Expr*       expr,
+    bool        mapitem
+);
+
+// Compiles a primary expression
+static bool compileprimaryexpr(
+    Compiler*   compiler,
+    Expr*       expr
+);
+
+// Compiles a secondary expression
+static bool compilesecondaryexpr(
+    Compiler*   compiler,
+    Expr*       expr
+);
+
+// Compiles the arguments of an invocation and the call itself
+static bool compileinvocation(
+    Compiler*   compiler,
+    Expr*       expr
+);
+
+// Compiles a call to a function literal as a copy of its body guarded by the
+// function being called (the arguments and the function are already pushed)
+static void compileinlinecall(
+    Compiler*   compiler,
+    uint32_t    function,
+    uint32_t    argcount
+);
+
+// Compiles an expression in parenthesis
+static bool compileparenexpr(
+    Compiler*   compiler,
+    Expr*       expr
+);
+
+// Compiles the binary operations following an already compiled left-hand
+// expression
+static bool compilebinexpr(
+    Compiler*   compiler,
+    int         prec,
+    Expr*       leftexpr,
+    bool        mapitem
+);
+
+// Compiles a map literal
+static bool compilemap(
+    Compiler*   compiler
+);
+
+// Compiles a function literal
+static bool compilefunction(
+    Compiler*   compiler
+);
+
+// Returns the interned string ID of the current string or identifier token
+// and moves to the next token
+static StringId compilestringorident(
+    Compiler*   compiler
+);
+
+// Remembers the function literal assigned to a variable by a statement given
+// where the code of the statement starts, if calls to it can be inlined
+static void defineinlinefunction(
+    Compiler*   compiler,
+    uint32_t    start
+);
+
+// Finds the function literal which a call to a variable with the given number
+// of arguments can be inlined into, returning true if there is one
+static bool findinlinefunction(
+    Compiler*   compiler,
+    StringId    id,
+    uint32_t    argcount,
+    uint32_t*   function
+);
+
+// Returns whether an instruction can be part of the body of an inlined
+// function, also returning how it changes the size of the stack (the
+// parameters are fetched from the stack instead of from the scope, so other
+// variables cannot be fetched, and the body may fall back to the call part
+// way through, so nothing can be modified)
+static bool isinlineinstruction(
+    const uint32_t* bytecode,
+    uint32_t        index,
+    const uint32_t* params,
+    uint32_t        paramcount,
+    int32_t*        effect
+);
+
+// Reverses the order of consecutive ranges of byte code given the start of
+// each range and the end of the last range
+static void reverseitems(
+    Compiler*       compiler,
+    const uint32_t* starts,
+    size_t          count,
+    uint32_t        end
+);
+
+bool compiler_compile(
+    Parser*         parser,
+    uint32_t*       bytecode,
+    ConstantPool*   constants,
+    uint32_t        index,
+    uint32_t*       end
+)
+{
+    assert(parser);
+    assert(bytecode);
+    assert(constants);
+    assert(end);
+
+    Compiler compiler = { parser, parser->lexer, bytecode, constants, index, false, { { 0, 0 } }, 0 };
+
+    LexerState state = lexer_savestate(parser->lexer);
+    uint32_t constantcount = constants->count;
+    if (!compileexprs(&compiler, true))
+    {
+        lexer_restorestate(parser->lexer, state);
+        constants->count = constantcount;
+        return false;
+    }
+
+    *end = compiler.index;
+    return true;
+}
+
+static bool compileexprs(
+    Compiler*   compiler,
+    bool        newlines
+)
+{
+    Lexer* lexer = compiler->lexer;
+    uint32_t inlinefunctioncount = compiler->inlinefunctioncount;
+    for (;;)
+    {
+        uint32_t start = compiler->index;
+
+        Expr expr;
+        if (!compileexpr(compiler, &expr, false))
+        {
+            compiler->inlinefunctioncount = inlinefunctioncount;
+            return false;
+        }
+
+        defineinlinefunction(compiler, start);
+
+        // Continue if there is a trailing comma or a new line
+        if (lexer_istokentypeandid(lexer, TOK_SYMBOL, ',') ||
+                (newlines && lexer_skippednewline(lexer) &&
+                 !lexer_istokentypeandid(lexer, TOK_SYMBOL, ']') &&
+                 !lexer_istokentypeandid(lexer, TOK_SYMBOL, '}')))
+        {
+            if (lexer_istokentypeandid(lexer, TOK_SYMBOL, ','))
+            {
+                lexer_next(lexer);
+            }
+
+            // Pop the result of that expression off of the stack since there
+            // is another expression in the sequence
+            OPCODE(OPCODE_POP);
+        }
+        else
+        {
+            compiler->inlinefunctioncount = inlinefunctioncount;
+            return true;
+        }
+    }
+}
+
+static bool compileexpr(
+    Compiler*   compiler,
+    Expr*       expr,
+    bool        mapitem
+)
+{
+    if (!compileprimaryexpr(compiler, expr))
+    {
+        return false;
+    }
+
+    return compilebinexpr(compiler, 0, expr, mapitem);
+}
+
+static bool compileprimaryexpr(
+    Compiler*   compiler,
+    Expr*       expr
+)
+{
+    Lexer* lexer = compiler->lexer;
+
+    // Unary operator
+    if (lexer_istokentype(lexer, TOK_OPERATOR))
+    {
+        Operator op = (Operator)lexer_gettokenid(lexer);
+        if (op == OP_SUB)
+        {
+            op = OP_NEG;
+        }
+
+        if (op != OP_NOT && op != OP_NEG)
+        {
+            return false;
+        }
+
+        lexer_next(lexer);
+
+        if (lexer_skippedwhitespace(lexer))
+        {
+            return false;
+        }
+
+        if (!compileprimaryexpr(compiler, expr))
+        {
+            return false;
+        }
+
+        compiler->index = emitoperation(compiler->bytecode, compiler->constants, expr->start, compiler->index, OP_OPCODE[op]);
+        expr->kind = EXPR_VALUE;
+        expr->item = false;
+        return true;
+    }
+    else
+    {
+        return compilesecondaryexpr(compiler, expr);
+    }
+}
+
+static bool compilesecondaryexpr(
+    Compiler*   compiler,
+    Expr*       expr
+)
+{
+    Lexer* lexer = compiler->lexer;
+
+    expr->kind = EXPR_VALUE;
+    expr->start = compiler->index;
+    expr->item = false;
+
+    bool result = false;
+    switch (lexer_gettokentype(lexer))
+    {
+    case TOK_SYMBOL:
+        switch (lexer_gettokenid(lexer))
+        {
+        case '(':
+            result = compileparenexpr(compiler, expr);
+            break;
+        case '{':
+            result = compilemap(compiler);
+            break;
+        case '[':
+            result = compilefunction(compiler);
+            break;
+        }
+        break;
+
+    case TOK_NUMBER:
+        OPCODE(OPCODE_PUSH);
+        CONSTANT(nom_fromdouble(lexer_gettokenasnumber(lexer)));
+        lexer_next(lexer);
+        result = true;
+        break;
+
+    case TOK_STRING:
+    {
+        StringId id = compilestringorident(compiler);
+        OPCODE(OPCODE_PUSH);
+        CONSTANT(string_newinterned(id));
+        result = true;
+    }
+    break;
+
+    case TOK_IDENT:
+        expr->kind = EXPR_IDENT;
+        expr->id = compilestringorident(compiler);
+        OPCODE(OPCODE_FETCH);
+        OPERAND(expr->id);
+        result = true;
+        break;
+
+    default:
+        break;
+    }
+
+    if (!result || lexer_skippedwhitespace(lexer))
+    {
+        return result;
+    }
+
+    // Compile any trailing indexing operations and invocations
+    for (;;)
+    {
+        // Check for bracket index
+        if (lexer_istokentypeandid(lexer, TOK_SYMBOL, '['))
+        {
+            lexer_next(lexer);
+
+            uint32_t keystart = compiler->index;
+
+            Expr key;
+            if (!compileexpr(compiler, &key, false))
+            {
+                return false;
+            }
+
+            // Expect a closing bracket
+            if (!lexer_istokentypeandid(lexer, TOK_SYMBOL, ']'))
+            {
+                return false;
+            }
+            lexer_next(lexer);
+
+            expr->kind = EXPR_INDEX;
+            expr->keystart = keystart;
+            expr->opindex = compiler->index;
+            expr->bracket = true;
+            expr->class = false;
+
+            OPCODE(OPCODE_GET);
+            OPERAND(INLINE_CACHE_NONE); // Allocated on first execution
+        }
+
+        // Check for dot index
+        else if (lexer_istokentypeandid(lexer, TOK_SYMBOL, '.'))
+        {
+            lexer_next(lexer);
+
+            // Check if it is a class index (double dot)
+            bool class = false;
+            if (!lexer_skippedwhitespace(lexer) &&
+                    lexer_istokentypeandid(lexer, TOK_SYMBOL, '.'))
+            {
+                lexer_next(lexer);
+                class = true;
+            }
+
+            // Expect an identifier
+            if (!lexer_istokentype(lexer, TOK_IDENT))
+            {
+                return false;
+            }
+
+            expr->kind = EXPR_INDEX;
+            expr->keystart = compiler->index;
+            expr->bracket = false;
+            expr->class = class;
+
+            if (class)
+            {
+                OPCODE(OPCODE_CLASSOF);
+            }
+
+            // Use the identifier as a string
+            expr->id = compilestringorident(compiler);
+            OPCODE(OPCODE_PUSH);
+            CONSTANT(string_newinterned(expr->id));
+
+            expr->opindex = compiler->index;
+            OPCODE(OPCODE_FIND);
+            OPERAND(INLINE_CACHE_NONE); // Allocated on first execution
+        }
+
+        // Check for invocation
+        else if (lexer_istokentypeandid(lexer, TOK_SYMBOL, ':'))
+        {
+            lexer_next(lexer);
+
+            if (!compileinvocation(compiler, expr))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            return true; // No more indices or invocations
+        }
+    }
+}
+
+static bool compileinvocation(
+    Compiler*   compiler,
+    Expr*       expr
+)
+{
+    Lexer* lexer = compiler->lexer;
+
+    uint32_t argcount = 0;
+
+    // If the function expression is referencing a class function then only
+    // keep the code pushing the object as the first argument
+    bool class = expr->kind == EXPR_INDEX && expr->class;
+    if (class)
+    {
+        compiler->index = expr->keystart;
+        ++argcount;
+    }
+
+    // Push the arguments
+    uint32_t argstart = compiler->index;
+    if (lexer_skippedwhitespace(lexer))
+    {
+        while (!lexer_skippednewline(lexer))
+        {
+            LexerState state = lexer_savestate(lexer);
+            uint32_t index = compiler->index;
+
+            // Try to compile an argument
+            Expr arg;
+            if (compileprimaryexpr(compiler, &arg))
+            {
+                ++argcount;
+            }
+            else if (compiler->unsupported)
+            {
+                return false;
+            }
+            else
+            {
+                // Failing to parse an argument indicates the end of the
+                // argument list
+                lexer_restorestate(lexer, state);
+                compiler->index = index;
+                break;
+            }
+        }
+    }
+
+    uint32_t function;
+    if (class)
+    {
+        // Look up the method in the class of the object and call it
+        OPCODE(OPCODE_CALL_METHOD);
+        OPERAND(expr->id);
+        OPERAND(argcount);
+    }
+    else if (expr->kind == EXPR_IDENT && findinlinefunction(compiler, expr->id, argcount, &function))
+    {
+        // Move the code pushing the function after the arguments and inline
+        // the call
+        swapcode(compiler->bytecode, expr->start, argstart, compiler->index);
+        compileinlinecall(compiler, function, argcount);
+    }
+    else
+    {
+        // Move the code pushing the function after the arguments and call it
+        swapcode(compiler->bytecode, expr->start, argstart, compiler->index);
+        OPCODE(OPCODE_CALL);
+        OPERAND(argcount);
+    }
+
+    expr->kind = EXPR_VALUE;
+    return true;
+}
+
+static void compileinlinecall(
+    Compiler*   compiler,
+    uint32_t    function,
+    uint32_t    argcount
+)
+{
+    uint32_t* bytecode = compiler->bytecode;
+    uint32_t entry = bytecode[function + 1];
+    uint32_t paramcount = bytecode[function + 2];
+    const uint32_t* params = &bytecode[function + 3];
+
+    // Continue with the copy of the body if the function being called is the
+    // inlined function
+    OPCODE(OPCODE_INLINE);
+    OPERAND(entry);
+    uint32_t callindices[COMPILER_MAX_INLINE_LENGTH + 1];
+    uint32_t callcount = 0;
+    callindices[callcount++] = compiler->index;
+    OPERAND(0); // This will be known once the body is copied
+
+    // Copy the body (which ends with the RET instruction before the FUNCTION
+    // instruction), reading the parameters from the arguments on the stack
+    // below the function
+    //
+    // The copy is longer than the body once guards are inserted, so the new
+    // location of each instruction is remembered to remap the jumps in it
+    uint32_t locations[COMPILER_MAX_INLINE_LENGTH + 1];
+    uint32_t jumpindices[COMPILER_MAX_INLINE_LENGTH];
+    uint32_t jumpcount = 0;
+    int32_t depth = 0;
+    for (uint32_t i = entry; i < function - 1; i += instructionlength(bytecode, i))
+    {
+        int32_t effect;
+        (void)isinlineinstruction(bytecode, i, params, paramcount, &effect);
+
+        locations[i - entry] = compiler->index;
+
+        OpCode op = (OpCode)bytecode[i];
+        if (op == OPCODE_FETCH)
+        {
+            uint32_t param = 0;
+            while (params[param] != bytecode[i + 1])
+            {
+                ++param;
+            }
+
+            OPCODE(OPCODE_DUP);
+            OPERAND((uint32_t)depth + argcount - param);
+        }
+        else
+        {
+            // Operator overloads must be called from the stack frame of the
+            // call, so arithmetic on anything but numbers falls back to it
+            if (op == OPCODE_ADD || op == OPCODE_SUB || op == OPCODE_MUL || op == OPCODE_DIV)
+            {
+                OPCODE(OPCODE_GUARD_NUM);
+                OPERAND((uint32_t)depth);
+                callindices[callcount++] = compiler->index;
+                OPERAND(0);
+            }
+
+            uint32_t length = instructionlength(bytecode, i);
+            memcpy(&bytecode[compiler->index], &bytecode[i], length * sizeof(uint32_t));
+            compiler->index += length;
+
+            if (op == OPCODE_JUMPIF)
+            {
+                jumpindices[jumpcount++] = compiler->index - 1;
+            }
+        }
+
+        depth += effect;
+    }
+    locations[function - 1 - entry] = compiler->index;
+
+    for (uint32_t i = 0; i < jumpcount; ++i)
+    {
+        bytecode[jumpindices[i]] = locations[bytecode[jumpindices[i]] - entry];
+    }
+
+    // Remove the arguments and the function from under the result and skip
+    // past the call
+    OPCODE(OPCODE_SLIDE);
+    OPERAND(argcount + 1);
+    OPCODE(OPCODE_JUMP);
+    uint32_t gotoindex = compiler->index;
+    OPERAND(0);
+
+    // Call the function if a guard failed
+    for (uint32_t i = 0; i < callcount; ++i)
+    {
+        bytecode[callindices[i]] = compiler->index;
+    }
+    OPCODE(OPCODE_CALL);
+    OPERAND(argcount);
+
+    bytecode[gotoindex] = compiler->index;
+}
+
+static bool compileparenexpr(
+    Compiler*   compiler,
+    Expr*       expr
+)
+{
+    Lexer* lexer = compiler->lexer;
+    lexer_next(lexer);
+
+    if (!compileexpr(compiler, expr, false))
+    {
+        return false;
+    }
+
+    if (!lexer_istokentypeandid(lexer, TOK_SYMBOL, ')'))
+    {
+        return false;
+    }
+
+    lexer_next(lexer);
+    return true;
+}
+
+static bool compilebinexpr(
+    Compiler*   compiler,
+    int         prec,
+    Expr*       leftexpr,
+    bool        mapitem
+)
+{
+    Lexer* lexer = compiler->lexer;
+
+    for (;;)
+    {
+        // Check that the current token is an operator
+        if (!lexer_istokentype(lexer, TOK_OPERATOR))
+        {
+            return true;
+        }
+
+        Operator op = (Operator)lexer_gettokenid(lexer);
+        int opprec = OP_PREC[op];
+
+        // This operator has less precedence
+        if (opprec < prec)
+        {
+            return true;
+        }
+
+        // A map item is either a ':=' or a '->' operation or not a binary
+        // operation at all
+        if (mapitem && (leftexpr->item || (op != OP_DEFINE && op != OP_ASSOC)))
+        {
+            compiler->unsupported = true;
+            return false;
+        }
+
+        // The left side of a ':=' expression must be an identifier
+        if (op == OP_DEFINE && leftexpr->kind != EXPR_IDENT &&
+                !(leftexpr->kind == EXPR_INDEX && !leftexpr->bracket && !mapitem))
+        {
+            compiler->unsupported = leftexpr->kind == EXPR_INDEX && !leftexpr->bracket;
+            return false;
+        }
+
+        // The left side of a '=' expression must be an identifier or index
+        if (op == OP_ASSIGN && leftexpr->kind == EXPR_VALUE)
+        {
+            compiler->unsupported = true;
+            return false;
+        }
+
+        // Associations are only valid in map items
+        if (op == OP_ASSOC && !mapitem)
+        {
+            compiler->unsupported = true;
+            return false;
+        }
+
+        // Move past the operator
+        lexer_next(lexer);
+
+        // Emit the code which precedes the right-hand expression
+        uint32_t gotoindex = 0;
+        bool constantleft = false;
+        bool shortcircuit = false;
+        NomValue constant;
+        if ((op == OP_OR || op == OP_AND) &&
+                readconstant(compiler->bytecode, compiler->constants, leftexpr->start, compiler->index, &constant))
+        {
+            constantleft = true;
+
+            // If the left expression is a constant then the operation either
+            // always short-circuits to the constant (the right expression is
+            // compiled and discarded) or always results in the truth of the
+            // right expression
+            shortcircuit = constantistrue(constant) == (op == OP_OR);
+            if (!shortcircuit)
+            {
+                compiler->index = leftexpr->start;
+            }
+        }
+        else if (op == OP_OR || op == OP_AND)
+        {
+            // Skip past the right expression if short-circuited
+            OPCODE(OPCODE_DUP);
+            OPERAND(0);
+            if (op == OP_AND)
+            {
+                OPCODE(OPCODE_NOT);
+            }
+            OPCODE(OPCODE_JUMPIF);
+            gotoindex = compiler->index;
+            OPERAND(0);
+        }
+        else if (op == OP_DEFINE || op == OP_ASSIGN)
+        {
+            // Only keep the code pushing the indexed value and the key of the
+            // left side
+            if (leftexpr->kind == EXPR_IDENT)
+            {
+                compiler->index = leftexpr->start;
+            }
+            else
+            {
+                compiler->index = leftexpr->opindex;
+            }
+        }
+
+        // Compile the right-hand expression
+        uint32_t middle = compiler->index;
+        Expr rightexpr;
+        if (!compileprimaryexpr(compiler, &rightexpr))
+        {
+            return false;
+        }
+
+        // If the next operator has more precedence then compile the next
+        // binary expression first
+        if (lexer_istokentype(lexer, TOK_OPERATOR))
+        {
+            int nextopprec = OP_PREC[lexer_gettokenid(lexer)];
+            if (opprec < nextopprec)
+            {
+                if (!compilebinexpr(compiler, opprec + 1, &rightexpr, false))
+                {
+                    return false;
+                }
+            }
+        }
+
+        // Emit the operation
+        if (mapitem)
+        {
+            if (op == OP_DEFINE)
+            {
+                // Use the identifier as the key
+                OPCODE(OPCODE_PUSH);
+                CONSTANT(string_newinterned(leftexpr->id));
+            }
+            else
+            {
+                // Push the value before the key
+                swapcode(compiler->bytecode, leftexpr->start, middle, compiler->index);
+            }
+
+            leftexpr->item = true;
+        }
+        else if (shortcircuit)
+        {
+            compiler->index = middle;
+        }
+        else if (constantleft)
+        {
+            compiler->index = emitoperation(compiler->bytecode, compiler->constants, leftexpr->start, compiler->index, OPCODE_NOT);
+            compiler->index = emitoperation(compiler->bytecode, compiler->constants, leftexpr->start, compiler->index, OPCODE_NOT);
+        }
+        else if (op == OP_OR || op == OP_AND)
+        {
+            OPCODE(OP_OPCODE[op]);
+            compiler->bytecode[gotoindex] = compiler->index;
+        }
+        else if (op == OP_DEFINE || op == OP_ASSIGN)
+        {
+            if (leftexpr->kind == EXPR_IDENT)
+            {
+                OPCODE(OP_OPCODE[op]);
+                OPERAND(leftexpr->id);
+            }
+            else
+            {
+                swapcode(compiler->bytecode, leftexpr->start, middle, compiler->index);
+
+                if (op == OP_DEFINE)
+                {
+                    OPCODE(OPCODE_INSERT);
+                }
+                else if (leftexpr->bracket)
+                {
+                    OPCODE(OPCODE_SET);
+                }
+                else
+                {
+                    OPCODE(OPCODE_UPDATE);
+                }
+            }
+        }
+        else
+        {
+            // Evaluate the right-hand expression first
+            swapcode(compiler->bytecode, leftexpr->start, middle, compiler->index);
+            compiler->index = emitoperation(compiler->bytecode, compiler->constants, leftexpr->start, compiler->index, OP_OPCODE[op]);
+        }
+
+        leftexpr->kind = EXPR_VALUE;
+    }
+}
+
+static bool compilemap(
+    Compiler*   compiler
+)
+{
+    Lexer* lexer = compiler->lexer;
+    lexer_next(lexer);
+
+    // An empty map
+    if (lexer_istokentypeandid(lexer, TOK_SYMBOL, '}'))
+    {
+        lexer_next(lexer);
+
+        OPCODE(OPCODE_MAP);
+        OPERAND(0);
+        return true;
+    }
+
+    // Compile the items, remembering where the code of each starts
+    uint32_t* starts = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    bool result = true;
+    for (;;)
+    {
+        if (count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 16;
+            starts = (uint32_t*)realloc(starts, capacity * sizeof(uint32_t));
+            assert(starts);
+        }
+        starts[count] = compiler->index;
+
+        Expr item;
+        if (!compileexpr(compiler, &item, true))
+        {
+            result = false;
+            break;
+        }
+
+        // Infer the key if it is not an association
+        if (!item.item)
+        {
+            OPCODE(OPCODE_PUSH);
+            CONSTANT(nom_fromdouble((double)count));
+        }
+
+        ++count;
+
+        if (lexer_istokentypeandid(lexer, TOK_SYMBOL, ','))
+        {
+            lexer_next(lexer);
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (result && !lexer_istokentypeandid(lexer, TOK_SYMBOL, '}'))
+    {
+        result = false;
+    }
+
+    if (result)
+    {
+        lexer_next(lexer);
+
+        // Push all map items on the stack in reverse order
+        reverseitems(compiler, starts, count, compiler->index);
+
+        OPCODE(OPCODE_MAP);
+        OPERAND((uint32_t)count);
+    }
+
+    free(starts);
+    return result;
+}
+
+static bool compilefunction(
+    Compiler*   compiler
+)
+{
+    Lexer* lexer = compiler->lexer;
+    lexer_next(lexer);
+
+    // Go to the end of the function body
+    OPCODE(OPCODE_JUMP);
+    uint32_t gotoindex = compiler->index;
+    OPERAND(0); // This will be known once the function code is compiled
+
+    // Remember the instruction pointer where the function begins
+    uint32_t ip = compiler->index;
+
+    // Count the parameters (they are emitted once the body is compiled)
+    LexerState paramstate = lexer_savestate(lexer);
+    uint32_t paramcount = 0;
+    for (;;)
+    {
+        if (!lexer_istokentype(lexer, TOK_IDENT))
+        {
+            // Restart at the beginning if the parameter parsing failed
+            lexer_restorestate(lexer, paramstate);
+            paramcount = 0;
+            break;
+        }
+
+        lexer_next(lexer);
+        ++paramcount;
+
+        if (lexer_istokentypeandid(lexer, TOK_SYMBOL, '|'))
+        {
+            lexer_next(lexer);
+            break;
+        }
+    }
+
+    // Compile the function body
+    if (!compileexprs(compiler, true))
+    {
+        return false;
+    }
+
+    if (!lexer_istokentypeandid(lexer, TOK_SYMBOL, ']'))
+    {
+        return false;
+    }
+    lexer_next(lexer);
+
+    OPCODE(OPCODE_RET);
+
+    // Re-write the goto instruction pointer
+    compiler->bytecode[gotoindex] = compiler->index;
+
+    // Create the function
+    OPCODE(OPCODE_FUNCTION);
+    OPERAND(ip);
+    OPERAND(paramcount);
+
+    // Emit the parameter names by lexing them again
+    if (paramcount > 0)
+    {
+        LexerState state = lexer_savestate(lexer);
+        lexer_restorestate(lexer, paramstate);
+
+        for (uint32_t i = 0; i < paramcount; ++i)
+        {
+            OPERAND(compilestringorident(compiler));
+        }
+
+        lexer_restorestate(lexer, state);
+    }
+
+    return true;
+}
+
+static StringId compilestringorident(
+    Compiler*   compiler
+)
+{
+    Lexer* lexer = compiler->lexer;
+    StringPool* stringpool = compiler->parser->stringpool;
+
+    size_t length = lexer_gettokenlength(lexer);
+    const char* string = lexer_gettokenstring(lexer);
+    Hash hash = lexer_gettokenhash(lexer);
+    StringId id = stringpool_getidhashed(stringpool, string, length, hash);
+
+    // Compiled code is never released so the strings it references are never
+    // collected
+    stringpool_pin(stringpool, id);
+
+    lexer_next(lexer);
+
+    return id;
+}
+
+static void defineinlinefunction(
+    Compiler*   compiler,
+    uint32_t    start
+)
+{
+    uint32_t* bytecode = compiler->bytecode;
+    uint32_t end = compiler->index;
+
+    if (compiler->inlinefunctioncount == COMPILER_MAX_INLINE_FUNCTIONS)
+    {
+        return;
+    }
+
+    // Match the code of '<identifier> := [ ... ]' (a jump past the body, the
+    // body, the FUNCTION instruction and the DEFINE instruction)
+    if (end - start < 4 || bytecode[start] != OPCODE_JUMP || bytecode[end - 2] != OPCODE_DEFINE)
+    {
+        return;
+    }
+
+    uint32_t function = bytecode[start + 1];
+    if (function <= start + 2 || function >= end || bytecode[function] != OPCODE_FUNCTION ||
+            function + instructionlength(bytecode, function) != end - 2 ||
+            bytecode[function + 1] != start + 2 || bytecode[function - 1] != OPCODE_RET)
+    {
+        return;
+    }
+
+    uint32_t entry = bytecode[function + 1];
+    uint32_t paramcount = bytecode[function + 2];
+    const uint32_t* params = &bytecode[function + 3];
+
+    if (function - 1 - entry > COMPILER_MAX_INLINE_LENGTH)
+    {
+        return;
+    }
+
+    // Each parameter must be distinct for it to be read from its own argument
+    for (uint32_t i = 0; i < paramcount; ++i)
+    {
+        for (uint32_t j = i + 1; j < paramcount; ++j)
+        {
+            if (params[i] == params[j])
+            {
+                return;
+            }
+        }
+    }
+
+    // The body must be a single expression using only instructions which
+    // behave the same without a stack frame of their own
+    int32_t depth = 0;
+    for (uint32_t i = entry; i < function - 1; i += instructionlength(bytecode, i))
+    {
+        int32_t effect;
+        if (!isinlineinstruction(bytecode, i, params, paramcount, &effect))
+        {
+            return;
+        }
+
+        depth += effect;
+    }
+
+    if (depth != 1)
+    {
+        return;
+    }
+
+    InlineFunction* inlinefunction = &compiler->inlinefunctions[compiler->inlinefunctioncount++];
+    inlinefunction->id = bytecode[end - 1];
+    inlinefunction->function = function;
+}
+
+static bool findinlinefunction(
+    Compiler*   compiler,
+    StringId    id,
+    uint32_t    argcount,
+    uint32_t*   function
+)
+{
+    // The latest definition of the variable is the one in scope
+    for (uint32_t i = compiler->inlinefunctioncount; i-- > 0;)
+    {
+        InlineFunction* inlinefunction = &compiler->inlinefunctions[i];
+        if (inlinefunction->id == id)
+        {
+            *function = inlinefunction->function;
+            return compiler->bytecode[*function + 2] == argcount;
+        }
+    }
+
+    return false;
+}
+
+static bool isinlineinstruction(
+    const uint32_t* bytecode,
+    uint32_t        index,
+    const uint32_t* params,
+    uint32_t        paramcount,
+    int32_t*        effect
+)
+{
+    switch ((OpCode)bytecode[index])
+    {
+    case OPCODE_FETCH:
+        *effect = 1;
+        for (uint32_t i = 0; i < paramcount; ++i)
+        {
+            if (params[i] == bytecode[index + 1])
+            {
+                return true;
+            }
+        }
+        return false;
+    case OPCODE_PUSH:
+    case OPCODE_DUP:
+        *effect = 1;
+        return true;
+    case OPCODE_NEG:
+    case OPCODE_NOT:
+    case OPCODE_CLASSOF:
+        *effect = 0;
+        return true;
+    case OPCODE_ADD:
+    case OPCODE_SUB:
+    case OPCODE_MUL:
+    case OPCODE_DIV:
+    case OPCODE_EQ:
+    case OPCODE_NE:
+    case OPCODE_GT:
+    case OPCODE_GTE:
+    case OPCODE_LT:
+    case OPCODE_LTE:
+    case OPCODE_AND:
+    case OPCODE_OR:
+    case OPCODE_FIND:
+    case OPCODE_GET:
+    case OPCODE_JUMPIF:
+        *effect = -1;
+        return true;
+    case OPCODE_MAP:
+        *effect = 1 - 2 * (int32_t)bytecode[index + 1];
+        return true;
+    default:
+        *effect = 0;
+        return false;
+    }
+}
+
+static void reverseitems(
+    Compiler*       compiler,
+    const uint32_t* starts,
+    size_t          count,
+    uint32_t        end
+)
+{
+    if (count < 2)
+    {
+        return;
+    }
+
+    uint32_t* bytecode = compiler->bytecode;
+    uint32_t start = starts[0];
+    uint32_t length = end - start;
+
+    uint32_t* buffer = (uint32_t*)malloc(length * sizeof(uint32_t));
+    assert(buffer);
+    memcpy(buffer, &bytecode[start], length * sizeof(uint32_t));
+
+    // Copy each item back starting from the last one
+    uint32_t index = start;
+    for (size_t i = count; i-- > 0;)
+    {
+        uint32_t itemstart = starts[i];
+        uint32_t itemend = i + 1 < count ? starts[i + 1] : end;
+        uint32_t itemlength = itemend - itemstart;
+
+        memcpy(&bytecode[index], &buffer[itemstart - start], itemlength * sizeof(uint32_t));
+        relocatecode(bytecode, index, index + itemlength, (int32_t)index - (int32_t)itemstart);
+        index += itemlength;
+    }
+
+    free(buffer);
+}
@@ -244,12 +244,12 @@ Hash hashstring(
     (void)context;
 
     char* s = (char*)key;
-    Hash hash = 5381;
+    Hash hash = HASH_STRING_INITIAL;
 
     char c;
     while ((c = *s++) != '\0')
     {
-        hash = ((hash << 5) + hash) + c;
+        hash = HASH_STRING_STEP(hash, c);
     }
 
     return hash;
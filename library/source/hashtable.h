@@ -34,6 +34,13 @@ typedef uint64_t UserData;
 // The result of a hash
 typedef uint64_t Hash;
 
+// The initial value of a string hash
+#define HASH_STRING_INITIAL         (5381)
+
+// Combines the next character of a string into a string hash (strings hashed
+// one character at a time must match hashstring())
+#define HASH_STRING_STEP(hash, c)   ((((hash) << 5) + (hash)) + (c))
+
 // A hash function
 typedef Hash (*HashFunction)(
     UserData    key,
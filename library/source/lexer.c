@@ -25,10 +25,82 @@
 #include "node.h"
 
 #include <assert.h>
+#include <float.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#include <ctype.h>
+
+// Scan whole blocks of the source at a time when vector instructions are
+// available
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+#define LEXER_BLOCK_SIZE    (32)
+#define LEXER_BLOCK_FULL    (0xFFFFFFFFu)
+
+typedef __m256i Block;
+
+#define BLOCK_LOAD(p)       _mm256_loadu_si256((const __m256i*)(p))
+#define BLOCK_SET(c)        _mm256_set1_epi8((char)(c))
+#define BLOCK_EQ(a, b)      _mm256_cmpeq_epi8(a, b)
+#define BLOCK_OR(a, b)      _mm256_or_si256(a, b)
+#define BLOCK_AND(a, b)     _mm256_and_si256(a, b)
+#define BLOCK_MIN(a, b)     _mm256_min_epu8(a, b)
+#define BLOCK_MAX(a, b)     _mm256_max_epu8(a, b)
+#define BLOCK_MASK(a)       ((uint32_t)_mm256_movemask_epi8(a))
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+
+#define LEXER_BLOCK_SIZE    (16)
+#define LEXER_BLOCK_FULL    (0xFFFFu)
+
+typedef __m128i Block;
+
+#define BLOCK_LOAD(p)       _mm_loadu_si128((const __m128i*)(p))
+#define BLOCK_SET(c)        _mm_set1_epi8((char)(c))
+#define BLOCK_EQ(a, b)      _mm_cmpeq_epi8(a, b)
+#define BLOCK_OR(a, b)      _mm_or_si128(a, b)
+#define BLOCK_AND(a, b)     _mm_and_si128(a, b)
+#define BLOCK_MIN(a, b)     _mm_min_epu8(a, b)
+#define BLOCK_MAX(a, b)     _mm_max_epu8(a, b)
+#define BLOCK_MASK(a)       ((uint32_t)_mm_movemask_epi8(a))
+#endif
+
+// The most significant digits which always fit in a 64-bit mantissa
+#define LEXER_MAX_MANTISSA_DIGITS   (19)
+
+// The largest integer every smaller integer of which is exactly representable
+// as a double
+#define LEXER_MAX_EXACT_INTEGER     ((uint64_t)1 << 53)
+
+// The largest power of 10 which is exactly representable as a double
+#define LEXER_MAX_EXACT_POWER       (22)
+
+// The longest number literal parsed without allocating memory
+#define LEXER_MAX_NUMBER_LENGTH     (128)
+
+#define CHAR_SPACE  (1)
+#define CHAR_ALPHA  (2)
+#define CHAR_DIGIT  (4)
+
+#define ISSPACE(c)  (charclasses[(unsigned char)(c)] & CHAR_SPACE)
+#define ISALPHA(c)  (charclasses[(unsigned char)(c)] & CHAR_ALPHA)
+#define ISDIGIT(c)  (charclasses[(unsigned char)(c)] & CHAR_DIGIT)
+#define ISIDENT(c)  (charclasses[(unsigned char)(c)] & (CHAR_ALPHA | CHAR_DIGIT))
+
+// The class of each character (1 is whitespace, 2 is a letter or underscore,
+// and 4 is a digit)
+static const unsigned char charclasses[256] =
+{
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0,
+    0, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 0, 0, 0, 2,
+    0, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 0, 0, 0, 0
+};
 
 // Moves to the next character and returns it
 char readnext(
@@ -46,16 +118,71 @@ bool startswith(
     const char* pre
 );
 
+// Returns the index of the first non-whitespace character at or after an
+// index, adding the number of new lines skipped
+static unsigned skipwhitespace(
+    Lexer*      lexer,
+    unsigned    index,
+    unsigned*   newlines
+);
+
+// Returns the index of the first occurrence of a character at or after an
+// index (the length of the source if there is none), adding the number of new
+// lines skipped before it
+static unsigned findchar(
+    Lexer*      lexer,
+    unsigned    index,
+    char        c,
+    unsigned*   newlines
+);
+
+// Returns the index of the first character at or after an index which cannot
+// be part of an identifier
+static unsigned skipidentifier(
+    Lexer*      lexer,
+    unsigned    index
+);
+
+#ifdef LEXER_BLOCK_SIZE
+
+// Returns the number of trailing zero bits of a non-zero mask
+static unsigned counttrailingzeros(
+    uint32_t    mask
+);
+
+// Returns the number of set bits in a mask
+static unsigned countbits(
+    uint32_t    mask
+);
+
+// Returns a block with bytes set where the bytes of a block are within an
+// inclusive range
+static Block inrange(
+    Block   block,
+    char    low,
+    char    high
+);
+
+#endif
+
+// Returns the double nearest to a decimal number literal of the form
+// digits[.digits] (the string does not need to be NULL terminated)
+static double parsenumber(
+    const char* str,
+    size_t      length
+);
+
 Lexer* lexer_new(
     const char* source
 )
 {
-    LexerState state = { 0, 1, TOK_SYMBOL, 0, 0, 0, 0 };
+    LexerState state = { 0, 1, TOK_SYMBOL, 0, 0, 0, 0, 0, 0 };
     Lexer* lexer = (Lexer*)malloc(sizeof(Lexer));
     assert(lexer);
 
     lexer->state = state;
     lexer->source = source;
+    lexer->length = strlen(source);
     return lexer;
 }
 
@@ -63,90 +190,73 @@ bool lexer_next(
     Lexer*  lexer
 )
 {
+    const char* source = lexer->source;
+
     lexer->state.skippedwhitespace = false;
     lexer->state.skippednewline = false;
 
-    // Skip whitespace
-    char c;
-    do
+    // Skip whitespace and comments
+    unsigned index = lexer->state.index;
+    for (;;)
     {
-        c = readnext(lexer);
-
-        if (c == '\0')
-        {
-            lexer->state.skippedwhitespace = false;
-            lexer->state.skippednewline = false;
-            return false;
-        }
-
-        if (isspace(c))
-        {
-            lexer->state.skippedwhitespace = true;
-        }
-
-        if (c == '\n')
-        {
-            lexer->state.skippednewline = true;
-        }
+        unsigned newlines = 0;
+        unsigned start = index;
+        index = skipwhitespace(lexer, index, &newlines);
 
         // Skip single-line comments
-        if (c == '-' && peeknext(lexer) == '-')
+        if (source[index] == '-' && source[index + 1] == '-')
         {
-            lexer->state.skippedwhitespace = true;
-            readnext(lexer);
-
-            do
+            index = findchar(lexer, index + 2, '\n', &newlines);
+            if (index < lexer->length)
             {
-                c = readnext(lexer);
-                if (c == '\0')
-                {
-                    return false;
-                }
-            }
-            while (c != '\n');
-            lexer->state.skippednewline = true;
-
-            c = readnext(lexer);
-            if (c == '\0')
-            {
-                return false;
+                ++newlines;
+                ++index;
             }
         }
 
         // Skip multi-line comments
-        if (c == '{' && peeknext(lexer) == '-')
+        else if (source[index] == '{' && source[index + 1] == '-')
         {
-            readnext(lexer);
-
-            do
+            index += 2;
+            while (index < lexer->length)
             {
-                c = readnext(lexer);
-                if (c == '\0')
-                {
-                    return false;
-                }
-                else if (c == '\n')
+                index = findchar(lexer, index, '-', &newlines);
+                if (index < lexer->length && source[++index] == '}')
                 {
-                    lexer->state.skippednewline = true;
+                    ++index;
+                    break;
                 }
             }
-            while ((c != '-' || peeknext(lexer) != '}') && c != '\0');
-
-            readnext(lexer);
-            c = readnext(lexer);
-            if (c == '\0')
-            {
-                return false;
-            }
-            else if (c == '\n')
-            {
-                lexer->state.skippednewline = true;
-            }
+        }
 
+        if (index != start)
+        {
             lexer->state.skippedwhitespace = true;
         }
+
+        if (newlines > 0)
+        {
+            lexer->state.line += newlines;
+            lexer->state.skippednewline = true;
+        }
+
+        if (index == start || index >= lexer->length)
+        {
+            break;
+        }
     }
-    while (isspace(c));
+
+    lexer->state.index = index;
+    if (index >= lexer->length)
+    {
+        lexer->state.index = (unsigned)lexer->length + 1;
+        lexer->state.type = TOK_EOI;
+        lexer->state.skippedwhitespace = false;
+        lexer->state.skippednewline = false;
+        return false;
+    }
+
+    char c = readnext(lexer);
 
     // Keep the token's start index and assume it is at least length 1
     lexer->state.startindex = lexer->state.index - 1;
@@ -265,23 +375,29 @@ bool lexer_next(
     lexer->state = state;
 
     // Identifier
-    if (isalpha(c) || c == '_')
+    if (ISALPHA(c))
     {
-        while (isalnum(peeknext(lexer)) || peeknext(lexer) == '_')
+        unsigned end = skipidentifier(lexer, lexer->state.index);
+
+        Hash hash = HASH_STRING_INITIAL;
+        for (unsigned i = lexer->state.startindex; i < end; ++i)
         {
-            readnext(lexer);
-            ++lexer->state.length;
+            hash = HASH_STRING_STEP(hash, source[i]);
         }
 
+        lexer->state.index = end;
+        lexer->state.length = end - lexer->state.startindex;
+        lexer->state.hash = hash;
+
         lexer->state.type = TOK_IDENT;
 
         return true;
     }
 
     // Number
-    if (isdigit(c))
+    if (ISDIGIT(c))
     {
-        while (isdigit(peeknext(lexer)))
+        while (ISDIGIT(peeknext(lexer)))
         {
             readnext(lexer);
             ++lexer->state.length;
@@ -292,7 +408,7 @@ bool lexer_next(
             readnext(lexer);
             ++lexer->state.length;
 
-            while (isdigit(peeknext(lexer)))
+            while (ISDIGIT(peeknext(lexer)))
             {
                 readnext(lexer);
                 ++lexer->state.length;
@@ -306,15 +422,21 @@ bool lexer_next(
     // String
     if (c == '\"')
     {
-        while (peeknext(lexer) != '\"')
+        // An unterminated string ends at the end of the source
+        unsigned newlines = 0;
+        unsigned end = findchar(lexer, lexer->state.index, '\"', &newlines);
+
+        Hash hash = HASH_STRING_INITIAL;
+        for (unsigned i = lexer->state.index; i < end; ++i)
         {
-            readnext(lexer);
-            ++lexer->state.length;
+            hash = HASH_STRING_STEP(hash, source[i]);
         }
-        readnext(lexer);
 
-        --lexer->state.length;
-        ++lexer->state.startindex;
+        lexer->state.startindex = lexer->state.index;
+        lexer->state.length = end - lexer->state.index;
+        lexer->state.index = end < lexer->length ? end + 1 : end;
+        lexer->state.line += newlines;
+        lexer->state.hash = hash;
 
         lexer->state.type = TOK_STRING;
         return true;
@@ -394,11 +516,18 @@ const char* lexer_gettokenstring(
     return &lexer->source[lexer->state.startindex];
 }
 
+Hash lexer_gettokenhash(
+    Lexer*  lexer
+)
+{
+    return lexer->state.hash;
+}
+
 double lexer_gettokenasnumber(
     Lexer*  lexer
 )
 {
-    return atof(lexer_gettokenstring(lexer));
+    return parsenumber(lexer_gettokenstring(lexer), lexer->state.length);
 }
 
 LexerState lexer_savestate(
@@ -458,3 +587,258 @@ bool startswith(
     size_t strlength = strlen(str);
     return strlength < prelength ? false : strncmp(pre, str, prelength) == 0;
 }
+
+static unsigned skipwhitespace(
+    Lexer*      lexer,
+    unsigned    index,
+    unsigned*   newlines
+)
+{
+    const char* source = lexer->source;
+
+#ifdef LEXER_BLOCK_SIZE
+    const Block space = BLOCK_SET(' ');
+    const Block newline = BLOCK_SET('\n');
+    while (index + LEXER_BLOCK_SIZE <= lexer->length)
+    {
+        Block block = BLOCK_LOAD(&source[index]);
+        uint32_t spaces = BLOCK_MASK(BLOCK_OR(BLOCK_EQ(block, space), inrange(block, '\t', '\r')));
+        uint32_t lines = BLOCK_MASK(BLOCK_EQ(block, newline));
+        if (spaces != LEXER_BLOCK_FULL)
+        {
+            unsigned offset = counttrailingzeros(~spaces);
+            *newlines += countbits(lines & ((1u << offset) - 1));
+            return index + offset;
+        }
+
+        *newlines += countbits(lines);
+        index += LEXER_BLOCK_SIZE;
+    }
+#endif
+
+    while (ISSPACE(source[index]))
+    {
+        if (source[index++] == '\n')
+        {
+            ++*newlines;
+        }
+    }
+
+    return index;
+}
+
+static unsigned findchar(
+    Lexer*      lexer,
+    unsigned    index,
+    char        c,
+    unsigned*   newlines
+)
+{
+    const char* source = lexer->source;
+
+#ifdef LEXER_BLOCK_SIZE
+    const Block target = BLOCK_SET(c);
+    const Block newline = BLOCK_SET('\n');
+    while (index + LEXER_BLOCK_SIZE <= lexer->length)
+    {
+        Block block = BLOCK_LOAD(&source[index]);
+        uint32_t matches = BLOCK_MASK(BLOCK_EQ(block, target));
+        uint32_t lines = BLOCK_MASK(BLOCK_EQ(block, newline));
+        if (matches)
+        {
+            unsigned offset = counttrailingzeros(matches);
+            *newlines += countbits(lines & ((1u << offset) - 1));
+            return index + offset;
+        }
+
+        *newlines += countbits(lines);
+        index += LEXER_BLOCK_SIZE;
+    }
+#endif
+
+    while (index < lexer->length && source[index] != c)
+    {
+        if (source[index++] == '\n')
+        {
+            ++*newlines;
+        }
+    }
+
+    return index;
+}
+
+static unsigned skipidentifier(
+    Lexer*      lexer,
+    unsigned    index
+)
+{
+    const char* source = lexer->source;
+
+#ifdef LEXER_BLOCK_SIZE
+    const Block underscore = BLOCK_SET('_');
+    const Block lowercase = BLOCK_SET(0x20);
+    while (index + LEXER_BLOCK_SIZE <= lexer->length)
+    {
+        Block block = BLOCK_LOAD(&source[index]);
+
+        // Setting 0x20 maps upper-case letters to lower-case and nothing
+        // else into the lower-case range
+        Block letters = inrange(BLOCK_OR(block, lowercase), 'a', 'z');
+        Block digits = inrange(block, '0', '9');
+        uint32_t idents = BLOCK_MASK(BLOCK_OR(BLOCK_OR(letters, digits), BLOCK_EQ(block, underscore)));
+        if (idents != LEXER_BLOCK_FULL)
+        {
+            return index + counttrailingzeros(~idents);
+        }
+
+        index += LEXER_BLOCK_SIZE;
+    }
+#endif
+
+    while (ISIDENT(source[index]))
+    {
+        ++index;
+    }
+
+    return index;
+}
+
+static double parsenumber(
+    const char* str,
+    size_t      length
+)
+{
+    // Powers of 10 which are exactly representable as doubles
+    static const double powers[LEXER_MAX_EXACT_POWER + 1] =
+    {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+        1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    // Accumulate the significant digits into an integer mantissa
+    uint64_t mantissa = 0;
+    unsigned digits = 0;
+    unsigned fractiondigits = 0;
+    bool fraction = false;
+    for (size_t i = 0; i < length; ++i)
+    {
+        char c = str[i];
+        if (c == '.')
+        {
+            fraction = true;
+            continue;
+        }
+
+        if (fraction)
+        {
+            ++fractiondigits;
+        }
+
+        // Skip leading zeros and stop accumulating once the mantissa is full
+        if (mantissa > 0 || c != '0')
+        {
+            if (digits < LEXER_MAX_MANTISSA_DIGITS)
+            {
+                mantissa = mantissa * 10 + (uint64_t)(c - '0');
+            }
+            ++digits;
+        }
+    }
+
+    // The mantissa is exact and the scaling is a single correctly rounded
+    // operation on exact operands (only when doubles are evaluated at double
+    // precision)
+#if FLT_EVAL_METHOD == 0
+    if (digits <= LEXER_MAX_MANTISSA_DIGITS && mantissa <= LEXER_MAX_EXACT_INTEGER)
+    {
+        if (fractiondigits == 0)
+        {
+            return (double)mantissa;
+        }
+        else if (fractiondigits <= LEXER_MAX_EXACT_POWER)
+        {
+            return (double)mantissa / powers[fractiondigits];
+        }
+    }
+#else
+    (void)powers;
+#endif
+
+    // Otherwise fall back to strtod() with the literal rewritten using an
+    // exponent rather than a decimal point so the locale has no effect
+    char buffer[LEXER_MAX_NUMBER_LENGTH + 16];
+    char* copy = buffer;
+    if (length > LEXER_MAX_NUMBER_LENGTH)
+    {
+        copy = (char*)malloc(length + 16);
+        assert(copy);
+    }
+
+    size_t count = 0;
+    for (size_t i = 0; i < length; ++i)
+    {
+        if (str[i] != '.')
+        {
+            copy[count++] = str[i];
+        }
+    }
+    sprintf(&copy[count], "e-%u", fractiondigits);
+
+    double value = strtod(copy, NULL);
+
+    if (copy != buffer)
+    {
+        free(copy);
+    }
+
+    return value;
+}
+
+#ifdef LEXER_BLOCK_SIZE
+
+static unsigned counttrailingzeros(
+    uint32_t    mask
+)
+{
+#ifdef __GNUC__
+    return (unsigned)__builtin_ctz(mask);
+#else
+    unsigned count = 0;
+    while (!(mask & 1))
+    {
+        mask >>= 1;
+        ++count;
+    }
+    return count;
+#endif
+}
+
+static unsigned countbits(
+    uint32_t    mask
+)
+{
+#ifdef __GNUC__
+    return (unsigned)__builtin_popcount(mask);
+#else
+    unsigned count = 0;
+    while (mask)
+    {
+        mask &= mask - 1;
+        ++count;
+    }
+    return count;
+#endif
+}
+
+static Block inrange(
+    Block   block,
+    char    low,
+    char    high
+)
+{
+    Block lower = BLOCK_MAX(block, BLOCK_SET(low));
+    Block upper = BLOCK_MIN(block, BLOCK_SET(high));
+    return BLOCK_AND(BLOCK_EQ(lower, block), BLOCK_EQ(upper, block));
+}
+
+#endif
@@ -24,6 +24,8 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include "hashtable.h"
+
 #include <string.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -48,6 +50,7 @@ typedef struct LexerState
     unsigned    startindex;
     unsigned    length;
     unsigned    id;
+    Hash        hash;
     bool        skippedwhitespace;
     bool        skippednewline;
 } LexerState;
@@ -56,6 +59,7 @@ typedef struct LexerState
 typedef struct Lexer
 {
     const char* source;
+    size_t      length;
     LexerState  state;
 } Lexer;
 
@@ -123,6 +127,12 @@ const char* lexer_gettokenstring(
     Lexer*  lexer
 );
 
+// Returns the hash of the current identifier or string token (computed while
+// the token was lexed)
+Hash lexer_gettokenhash(
+    Lexer*  lexer
+);
+
 // Returns the value of the token as a number
 double lexer_gettokenasnumber(
     Lexer*  lexer
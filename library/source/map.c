@@ -30,24 +30,48 @@
 #include <assert.h>
 #include <stdlib.h>
 
-Hash hashvalue(
-    UserData    key,
-    UserData    context
-);
+// The key of an entry that has been removed (never a valid value)
+#define TOMBSTONE_KEY   (0xFFFFFFFF7FF7A507ull)
+
+#define IS_TOMBSTONE(e) ((e)->key.raw == TOMBSTONE_KEY)
 
-void freemapdata(
+// Frees the data of a map
+static void freemapdata(
     void*   data
 );
 
-bool comparevalue(
-    UserData    left,
-    UserData    right,
-    UserData    context
+// Finds the slot in the hash index for a key, returning the slot holding the
+// key's entry or the empty slot where the key's entry would be indexed
+static uint32_t* findslot(
+    NomState*   state,
+    MapData*    data,
+    NomValue    key,
+    Hash        hash
 );
 
-void insertkey(
+// Rebuilds the hash index of a map with the specified capacity
+static void rebuildindex(
     MapData*    data,
-    NomValue    key
+    size_t      indexcapacity
+);
+
+// Moves the remaining entries of a map over the entries that were removed
+static void compactentries(
+    MapData*    data
+);
+
+// Ensures that there is room in a map for another entry
+static void reserveentry(
+    MapData*    data
+);
+
+// Appends a new entry to a map and indexes it at the specified slot
+static void appendentry(
+    MapData*    data,
+    uint32_t*   slot,
+    NomValue    key,
+    NomValue    value,
+    Hash        hash
 );
 
 bool nom_ismap(
@@ -77,16 +101,58 @@ NomValue nom_newmap(
     NomValue map = heap_alloc(state->heap, OBJECTTYPE_MAP, sizeof(MapData), freemapdata);
 
     MapData* data = heap_getdata(state->heap, map);
-    data->hashtable = hashtable_new(hashvalue, comparevalue, (UserData)state, 32);
-    data->capacity = 32;
+    data->entries = (MapEntry*)malloc(sizeof(MapEntry) * MAP_INITIAL_CAPACITY);
+    assert(data->entries);
     data->count = 0;
-    data->keys = (NomValue*)malloc(sizeof(NomValue) * data->capacity);
+    data->removedcount = 0;
+    data->capacity = MAP_INITIAL_CAPACITY;
+    data->index = NULL;
+    data->indexcapacity = 0;
+    data->indexload = 0;
     data->contiguous = true;
     data->class = nom_nil();
+    data->version = 1;
+
+    rebuildindex(data, MAP_INITIAL_CAPACITY * 2);
 
     return map;
 }
 
+MapData* map_getdata(
+    NomState*   state,
+    NomValue    map
+)
+{
+    assert(state);
+
+    MapData* data = NULL;
+
+    HeapObject* object = heap_getobject(state->heap, map);
+    if (object && object->type == OBJECTTYPE_MAP)
+    {
+        data = (MapData*)object->data;
+    }
+
+    return data;
+}
+
+bool map_findentry(
+    NomState*   state,
+    MapData*    data,
+    NomValue    key,
+    uint32_t*   entry
+)
+{
+    assert(state);
+    assert(data);
+    assert(entry);
+
+    uint32_t* slot = findslot(state, data, key, (Hash)nom_hash(state, key));
+    *entry = *slot;
+
+    return *slot != MAP_NO_ENTRY;
+}
+
 bool map_iscontiguous(
     NomState*   state,
     NomValue    map
@@ -96,14 +162,10 @@ bool map_iscontiguous(
 
     bool result = false;
 
-    HeapObject* object = heap_getobject(state->heap, map);
-    if (object && object->type == OBJECTTYPE_MAP && object->data)
+    MapData* data = map_getdata(state, map);
+    if (data)
     {
-        MapData* data = (MapData*)object->data;
-        if (data)
-        {
-            result = data->contiguous;
-        }
+        result = data->contiguous;
     }
 
     return result;
@@ -119,51 +181,48 @@ bool map_next(
 
     bool result = false;
 
-    HeapObject* object = heap_getobject(state->heap, map);
-    if (object && object->type == OBJECTTYPE_MAP && object->data)
+    MapData* data = map_getdata(state, map);
+    if (data)
     {
-        MapData* data = (MapData*)object->data;
-        if (data)
+        // If this is a new iterator
+        if (iterator->source.raw == 0)
         {
-            // If this is a new iterator
-            if (iterator->source.raw == 0)
-            {
-                iterator->source = map;
-                iterator->data.map.index = 0;
-            }
-            else
-            {
-                iterator->data.map.index += 1;
-            }
-
-            size_t index = iterator->data.map.index;
+            iterator->source = map;
+            iterator->data.map.index = 0;
+        }
+        else
+        {
+            iterator->data.map.index += 1;
+        }
 
-            // If the index is within the range of the keys in the map
-            if (index < data->count)
-            {
-                // Get the key at this index
-                NomValue key = data->keys[index];
+        // Skip over removed entries
+        size_t index = iterator->data.map.index;
+        while (index < data->count && IS_TOMBSTONE(&data->entries[index]))
+        {
+            ++index;
+        }
+        iterator->data.map.index = index;
 
-                // Get the value with the key
-                NomValue value;
-                hashtable_find(data->hashtable, (UserData)key.raw, (UserData*)&value.data);
+        // If the index is within the range of the entries in the map
+        if (index < data->count)
+        {
+            MapEntry* entry = &data->entries[index];
 
-                // Update the iterator
-                iterator->key = key;
-                iterator->value = value;
+            // Update the iterator
+            iterator->key = entry->key;
+            iterator->value = entry->value;
 
-                result = true;
-            }
+            result = true;
+        }
 
-            // The end of the map has been reached
-            else
-            {
-                iterator->source = nom_nil();
-                iterator->key = nom_nil();
-                iterator->value = nom_nil();
+        // The end of the map has been reached
+        else
+        {
+            iterator->source = nom_nil();
+            iterator->key = nom_nil();
+            iterator->value = nom_nil();
 
-                result = false;
-            }
+            result = false;
         }
     }
 
@@ -181,17 +240,17 @@ bool map_insert(
 
     bool result = false;
 
-    HeapObject* object = heap_getobject(state->heap, map);
-    if (object && object->type == OBJECTTYPE_MAP && object->data)
+    MapData* data = map_getdata(state, map);
+    if (data)
     {
-        MapData* data = (MapData*)object->data;
-        if (data)
+        reserveentry(data);
+
+        Hash hash = (Hash)nom_hash(state, key);
+        uint32_t* slot = findslot(state, data, key, hash);
+        if (*slot == MAP_NO_ENTRY)
         {
-            result = hashtable_insert(data->hashtable, (UserData)key.raw, (UserData)value.raw);
-            if (result)
-            {
-                insertkey(data, key);
-            }
+            appendentry(data, slot, key, value, hash);
+            result = true;
         }
     }
 
@@ -209,13 +268,66 @@ bool map_update(
 
     bool result = false;
 
-    HeapObject* object = heap_getobject(state->heap, map);
-    if (object && object->type == OBJECTTYPE_MAP && object->data)
+    MapData* data = map_getdata(state, map);
+    if (data)
+    {
+        uint32_t entry;
+        if (map_findentry(state, data, key, &entry))
+        {
+            data->entries[entry].value = value;
+            result = true;
+        }
+    }
+
+    return result;
+}
+
+bool map_remove(
+    NomState*   state,
+    NomValue    map,
+    NomValue    key
+)
+{
+    assert(state);
+
+    bool result = false;
+
+    MapData* data = map_getdata(state, map);
+    if (data)
     {
-        MapData* data = (MapData*)object->data;
-        if (data)
+        uint32_t* slot = findslot(state, data, key, (Hash)nom_hash(state, key));
+        if (*slot != MAP_NO_ENTRY)
         {
-            result = hashtable_update(data->hashtable, (UserData)key.raw, (UserData)value.raw);
+            uint32_t position = *slot;
+            size_t livecount = data->count - data->removedcount;
+
+            // A contiguous map remains contiguous only if its last key is
+            // removed
+            if (data->contiguous)
+            {
+                data->contiguous = IS_NUMBER(key) && (size_t)key.number == livecount - 1;
+            }
+
+            // Leave the slot in the index so that probing continues past it
+            *slot = MAP_REMOVED_ENTRY;
+
+            if (position == data->count - 1)
+            {
+                // The last entry can simply be dropped
+                data->count -= 1;
+            }
+            else
+            {
+                // Leave a tombstone which is compacted away later
+                data->entries[position].key.raw = TOMBSTONE_KEY;
+                data->entries[position].value = nom_nil();
+                data->removedcount += 1;
+            }
+
+            // Remembered entry positions may no longer be valid
+            ++data->version;
+
+            result = true;
         }
     }
 
@@ -233,11 +345,64 @@ bool map_find(
 
     bool result = false;
 
-    HeapObject* object = heap_getobject(state->heap, map);
-    if (object && object->type == OBJECTTYPE_MAP && object->data)
+    MapData* data = map_getdata(state, map);
+    if (data)
     {
-        MapData* data = (MapData*)object->data;
-        result = hashtable_find(data->hashtable, (UserData)key.raw, (UserData*)&value->data);
+        uint32_t entry;
+        if (map_findentry(state, data, key, &entry))
+        {
+            *value = data->entries[entry].value;
+            result = true;
+        }
+    }
+
+    return result;
+}
+
+bool map_findcached(
+    NomState*       state,
+    NomValue        map,
+    NomValue        key,
+    InlineCache*    cache,
+    NomValue*       value
+)
+{
+    assert(state);
+    assert(cache);
+
+    bool result = false;
+
+    MapData* data = map_getdata(state, map);
+    if (data)
+    {
+        uint32_t mapid = GET_ID(map);
+
+        // Look for a remembered lookup of the same key in the same version of
+        // the map
+        for (uint32_t i = 0; i < INLINE_CACHE_ENTRIES; ++i)
+        {
+            InlineCacheEntry* cached = &cache->entries[i];
+            if (cached->mapid == mapid && cached->version == data->version && cached->key.raw == key.raw)
+            {
+                *value = data->entries[cached->entry].value;
+                return true;
+            }
+        }
+
+        // Perform the full lookup and remember the position of the entry
+        uint32_t entry;
+        if (map_findentry(state, data, key, &entry))
+        {
+            InlineCacheEntry* cached = &cache->entries[cache->next];
+            cached->mapid = mapid;
+            cached->version = data->version;
+            cached->key = key;
+            cached->entry = entry;
+            cache->next = (cache->next + 1) % INLINE_CACHE_ENTRIES;
+
+            *value = data->entries[entry].value;
+            result = true;
+        }
     }
 
     return result;
@@ -254,17 +419,21 @@ bool map_set(
 
     bool result = false;
 
-    HeapObject* object = heap_getobject(state->heap, map);
-    if (object && object->type == OBJECTTYPE_MAP && object->data)
+    MapData* data = map_getdata(state, map);
+    if (data)
     {
-        MapData* data = (MapData*)object->data;
-        if (data)
+        reserveentry(data);
+
+        Hash hash = (Hash)nom_hash(state, key);
+        uint32_t* slot = findslot(state, data, key, hash);
+        if (*slot == MAP_NO_ENTRY)
         {
-            result = hashtable_set(data->hashtable, (UserData)key.raw, (UserData)value.raw);
-            if (result)
-            {
-                insertkey(data, key);
-            }
+            appendentry(data, slot, key, value, hash);
+            result = true;
+        }
+        else
+        {
+            data->entries[*slot].value = value;
         }
     }
 
@@ -279,10 +448,9 @@ void map_setclass(
 {
     assert(state);
 
-    HeapObject* object = heap_getobject(state->heap, map);
-    if (object && object->type == OBJECTTYPE_MAP && object->data)
+    MapData* data = map_getdata(state, map);
+    if (data)
     {
-        MapData* data = (MapData*)object->data;
         data->class = class;
     }
 }
@@ -296,27 +464,16 @@ NomValue map_getclass(
 
     NomValue class = nom_nil();
 
-    HeapObject* object = heap_getobject(state->heap, map);
-    if (object && object->type == OBJECTTYPE_MAP && object->data)
+    MapData* data = map_getdata(state, map);
+    if (data)
     {
-        MapData* data = (MapData*)object->data;
         class = data->class;
     }
 
     return class;
 }
 
-Hash hashvalue(
-    UserData    key,
-    UserData    context
-)
-{
-    NomState* state = (NomState*)context;
-    NomValue value = { key };
-    return nom_hash(state, value);
-}
-
-void freemapdata(
+static void freemapdata(
     void*   data
 )
 {
@@ -324,68 +481,182 @@ void freemapdata(
 
     MapData* mapdata = (MapData*)data;
 
-    // Free the hash table
-    if (mapdata->hashtable)
+    // Free the entries
+    if (mapdata->entries)
     {
-        hashtable_free(mapdata->hashtable, NULL, NULL);
+        free(mapdata->entries);
     }
 
-    // Free the array of keys
-    if (mapdata->keys)
+    // Free the hash index
+    if (mapdata->index)
     {
-        free(mapdata->keys);
+        free(mapdata->index);
     }
 
     free(mapdata);
 }
 
-bool comparevalue(
-    UserData    left,
-    UserData    right,
-    UserData    context
+static uint32_t* findslot(
+    NomState*   state,
+    MapData*    data,
+    NomValue    key,
+    Hash        hash
 )
 {
-    NomState* state = (NomState*)context;
-    NomValue leftvalue = { left };
-    NomValue rightvalue = { right };
+    size_t mask = data->indexcapacity - 1;
+    size_t position = (size_t)hash & mask;
+
+    // Probe linearly until the key's entry or an empty slot is found (the
+    // index is never full so this always terminates)
+    for (;;)
+    {
+        uint32_t* slot = &data->index[position];
+        if (*slot == MAP_NO_ENTRY)
+        {
+            return slot;
+        }
+        else if (*slot != MAP_REMOVED_ENTRY)
+        {
+            MapEntry* entry = &data->entries[*slot];
+            if (entry->hash == hash && nom_equals(state, entry->key, key))
+            {
+                return slot;
+            }
+        }
 
-    return nom_equals(state, leftvalue, rightvalue);
+        position = (position + 1) & mask;
+    }
 }
 
-void insertkey(
+static void rebuildindex(
     MapData*    data,
-    NomValue    key
+    size_t      indexcapacity
 )
 {
     assert(data);
 
-    // If there is not enough capacity
+    uint32_t* index = (uint32_t*)malloc(sizeof(uint32_t) * indexcapacity);
+    assert(index);
+
+    for (size_t i = 0; i < indexcapacity; ++i)
+    {
+        index[i] = MAP_NO_ENTRY;
+    }
+
+    // Index each entry using the hash remembered in the entry
+    size_t mask = indexcapacity - 1;
+    for (size_t i = 0; i < data->count; ++i)
+    {
+        if (IS_TOMBSTONE(&data->entries[i]))
+        {
+            continue;
+        }
+
+        size_t position = (size_t)data->entries[i].hash & mask;
+        while (index[position] != MAP_NO_ENTRY)
+        {
+            position = (position + 1) & mask;
+        }
+
+        index[position] = (uint32_t)i;
+    }
+
+    if (data->index)
+    {
+        free(data->index);
+    }
+
+    data->index = index;
+    data->indexcapacity = indexcapacity;
+    data->indexload = data->count - data->removedcount;
+}
+
+static void compactentries(
+    MapData*    data
+)
+{
+    assert(data);
+
+    size_t count = 0;
+    for (size_t i = 0; i < data->count; ++i)
+    {
+        if (!IS_TOMBSTONE(&data->entries[i]))
+        {
+            data->entries[count++] = data->entries[i];
+        }
+    }
+
+    data->count = count;
+    data->removedcount = 0;
+
+    // The positions of the entries changed
+    rebuildindex(data, data->indexcapacity);
+    ++data->version;
+}
+
+static void reserveentry(
+    MapData*    data
+)
+{
+    assert(data);
+
+    // If there is not enough capacity then either compact the entries if at
+    // least half of them were removed or double the capacity of the entries
     if (data->count >= data->capacity)
     {
-        // Double the capacity
-        data->capacity *= 2;
+        if (data->removedcount * 2 >= data->count)
+        {
+            compactentries(data);
+        }
+        else
+        {
+            data->capacity *= 2;
 
-        // Allocate a new array of keys
-        NomValue* newkeys = (NomValue*)malloc(sizeof(NomValue) * data->capacity);
+            MapEntry* entries = (MapEntry*)realloc(data->entries, sizeof(MapEntry) * data->capacity);
+            assert(entries);
+            data->entries = entries;
+        }
+    }
 
-        // Copy the keys from the old array of keys
-        for (size_t i = 0; i < data->count; ++i)
+    // Keep the hash index (including slots of removed entries) at most two
+    // thirds full
+    if ((data->indexload + 1) * 3 > data->indexcapacity * 2)
+    {
+        size_t indexcapacity = data->indexcapacity;
+        while ((data->count - data->removedcount + 1) * 3 > indexcapacity * 2)
         {
-            newkeys[i] = data->keys[i];
+            indexcapacity *= 2;
         }
 
-        // Free the old keys and use the new array
-        free(data->keys);
-        data->keys = newkeys;
+        rebuildindex(data, indexcapacity);
     }
+}
+
+static void appendentry(
+    MapData*    data,
+    uint32_t*   slot,
+    NomValue    key,
+    NomValue    value,
+    Hash        hash
+)
+{
+    assert(data);
+    assert(data->count < data->capacity);
+
+    // Append the entry at the end and index it
+    MapEntry* entry = &data->entries[data->count];
+    entry->key = key;
+    entry->value = value;
+    entry->hash = hash;
 
-    // Insert the key at the end
-    data->keys[data->count] = key;
+    *slot = (uint32_t)data->count;
     data->count += 1;
+    data->indexload += 1;
 
     if (data->contiguous)
     {
         // If the key matches the index then the map remains contiguous
-        data->contiguous = IS_NUMBER(key) && (data->count - 1) == (size_t)key.number;
+        size_t livecount = data->count - data->removedcount;
+        data->contiguous = IS_NUMBER(key) && (livecount - 1) == (size_t)key.number;
     }
 }
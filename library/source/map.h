@@ -28,17 +28,74 @@
 
 #include <nominal.h>
 
+#define MAP_INITIAL_CAPACITY    (8)
+#define MAP_NO_ENTRY            ((uint32_t)-1)
+#define MAP_REMOVED_ENTRY       ((uint32_t)-2)
+
+#define INLINE_CACHE_ENTRIES    (4)
+#define INLINE_CACHE_NONE       ((uint32_t)-1)
+
+// A key/value pair stored in a map
+typedef struct MapEntry
+{
+    NomValue    key;
+    NomValue    value;
+    Hash        hash;
+} MapEntry;
+
 // The internal data of a Nominal map
+//
+// Entries are stored in insertion order and the hash index maps each key to
+// the position of its entry, so iterating a map is a linear scan of the
+// entries.  Removed entries are left in place as tombstones until the entries
+// are compacted when more room is needed
 typedef struct MapData
 {
-    HashTable*  hashtable;
-    size_t      capacity;
+    MapEntry*   entries;
     size_t      count;
-    NomValue*   keys;
+    size_t      removedcount;
+    size_t      capacity;
+    uint32_t*   index;
+    size_t      indexcapacity;
+    size_t      indexload;
     bool        contiguous;
     NomValue    class;
+    uint32_t    version;
 } MapData;
 
+// A remembered lookup of a key in a specific map
+typedef struct InlineCacheEntry
+{
+    uint32_t    mapid;
+    uint32_t    version;
+    NomValue    key;
+    uint32_t    entry;
+} InlineCacheEntry;
+
+// The lookups remembered by a single FIND/GET instruction (starts out
+// monomorphic and becomes polymorphic as other maps are seen)
+typedef struct InlineCache
+{
+    InlineCacheEntry    entries[INLINE_CACHE_ENTRIES];
+    uint32_t            next;
+} InlineCache;
+
+// Returns the internal data of a map (NULL if the value is not a map)
+MapData* map_getdata(
+    NomState*   state,
+    NomValue    map
+);
+
+// Finds the position of the entry for a key in a map, returning true if an
+// entry exists for the key or false otherwise (the position remains valid as
+// long as the version of the map does not change)
+bool map_findentry(
+    NomState*   state,
+    MapData*    data,
+    NomValue    key,
+    uint32_t*   entry
+);
+
 // Returns whether the keys in a map are contiguous natural numbers starting
 // at zero
 bool map_iscontiguous(
@@ -72,6 +129,14 @@ bool map_update(
     NomValue    value
 );
 
+// Removes the value for a key in a map, returning true if the value was
+// removed or false if no value exists for the specified key
+bool map_remove(
+    NomState*   state,
+    NomValue    map,
+    NomValue    key
+);
+
 // Finds the value for a key in a map, returning true if the value was found
 // or false otherwise
 bool map_find(
@@ -81,6 +146,16 @@ bool map_find(
     NomValue*   value
 );
 
+// Finds the value for a key in a map using the lookups remembered in an
+// inline cache, returning true if the value was found or false otherwise
+bool map_findcached(
+    NomState*       state,
+    NomValue        map,
+    NomValue        key,
+    InlineCache*    cache,
+    NomValue*       value
+);
+
 // Inserts a new value or updates an existing value in a map, returning true
 // if a new value was inserted or false if an existing value was changed
 bool map_set(
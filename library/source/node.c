@@ -27,10 +27,13 @@
 #include <stdlib.h>
 
 Node* node_new(
+    Arena*      arena,
     NodeType    type
 )
 {
-    Node* node = (Node*)malloc(sizeof(Node));
+    assert(arena);
+
+    Node* node = (Node*)arena_alloc(arena, sizeof(Node));
     assert(node);
 
     memset(node, 0, sizeof(Node));
@@ -38,90 +41,6 @@ Node* node_new(
     return node;
 }
 
-void node_free(
-    Node*   node
-)
-{
-    assert(node);
-
-    switch (node->type)
-    {
-    case NODE_NUMBER:
-    case NODE_STRING:
-        break;
-    case NODE_MAP:
-        if (node->data.map.assoc)
-        {
-            node_free(node->data.map.assoc);
-        }
-        if (node->data.map.next)
-        {
-            node_free(node->data.map.next);
-        }
-        break;
-    case NODE_IDENT:
-        break;
-    case NODE_BINARY:
-        if (node->data.binary.leftexpr)
-        {
-            node_free(node->data.binary.leftexpr);
-        }
-        if (node->data.binary.rightexpr)
-        {
-            node_free(node->data.binary.rightexpr);
-        }
-        break;
-    case NODE_UNARY:
-        if (node->data.unary.expr)
-        {
-            node_free(node->data.unary.expr);
-        }
-        break;
-    case NODE_INDEX:
-        if (node->data.index.expr)
-        {
-            node_free(node->data.index.expr);
-        }
-        if (node->data.index.key)
-        {
-            node_free(node->data.index.key);
-        }
-        break;
-    case NODE_SEQUENCE:
-        if (node->data.sequence.expr)
-        {
-            node_free(node->data.sequence.expr);
-        }
-        if (node->data.sequence.next)
-        {
-            node_free(node->data.sequence.next);
-        }
-        break;
-    case NODE_FUNCTION:
-        if (node->data.function.params)
-        {
-            node_free(node->data.function.params);
-        }
-        if (node->data.function.exprs)
-        {
-            node_free(node->data.function.exprs);
-        }
-        break;
-    case NODE_INVOCATION:
-        if (node->data.invocation.expr)
-        {
-            node_free(node->data.invocation.expr);
-        }
-        if (node->data.invocation.args)
-        {
-            node_free(node->data.invocation.args);
-        }
-        break;
-    }
-
-    free(node);
-}
-
 const int OP_PREC[] =
 {
     1,      // OP_DEFINE
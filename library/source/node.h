@@ -24,6 +24,7 @@
 #ifndef NODE_H
 #define NODE_H
 
+#include "arena.h"
 #include "stringpool.h"
 
 // A binary/unary operator
@@ -149,14 +150,11 @@ typedef struct Node
     } data;
 } Node;
 
-// Creates a new abstract syntax node
+// Creates a new abstract syntax node allocated from an arena (the node is
+// freed along with the arena)
 Node* node_new(
+    Arena*      arena,
     NodeType    type
 );
 
-// Frees an abstract syntax node
-void node_free(
-    Node*   node
-);
-
 #endif
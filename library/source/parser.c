@@ -44,6 +44,7 @@ Parser* parser_new(
 
     parser->lexer = lexer_new(source);
     parser->stringpool = stringpool;
+    parser->arena = arena_new(PARSER_ARENA_CHUNK_SIZE);
 
     // Move to the first token
     lexer_next(parser->lexer);
@@ -63,6 +64,12 @@ void parser_free(
         free(parser->lexer);
     }
 
+    // Free all nodes
+    if (parser->arena)
+    {
+        arena_free(parser->arena);
+    }
+
     free(parser);
 }
 
@@ -116,14 +123,13 @@ Node* parser_exprs(
         exprs = parser_exprs(parser, newlines);
         if (!exprs)
         {
-            node_free(expr);
             return NULL;
         }
     }
 
     // Create a sequence node for this expression and the potential expressions
     // after it
-    Node* sequence = node_new(NODE_SEQUENCE);
+    Node* sequence = node_new(parser->arena, NODE_SEQUENCE);
     sequence->data.sequence.expr = expr;
     sequence->data.sequence.next = exprs;
     return sequence;
@@ -170,7 +176,7 @@ Node* parser_primaryexpr(
         }
 
         // Create the unary node around the expression
-        Node* unary = node_new(NODE_UNARY);
+        Node* unary = node_new(parser->arena, NODE_UNARY);
         unary->data.unary.op = op;
         unary->data.unary.expr = expr;
         return unary;
@@ -222,7 +228,7 @@ Node* parser_secondaryexpr(
 
     // Number literal
     case TOK_NUMBER:
-        node = node_new(NODE_NUMBER);
+        node = node_new(parser->arena, NODE_NUMBER);
         node->data.number.value = lexer_gettokenasnumber(parser->lexer);
         lexer_next(parser->lexer);
         break;
@@ -251,7 +257,6 @@ Node* parser_secondaryexpr(
                 Node* key = parser_expr(parser);
                 if (!key)
                 {
-                    node_free(node);
                     return NULL;
                 }
 
@@ -259,14 +264,12 @@ Node* parser_secondaryexpr(
                 if (!lexer_istokentypeandid(parser->lexer, TOK_SYMBOL, ']'))
                 {
                     parser_seterror(parser, "Expected closing ']'");
-                    node_free(key);
-                    node_free(node);
                     return NULL;
                 }
                 lexer_next(parser->lexer);
 
                 // Create the index node
-                Node* index = node_new(NODE_INDEX);
+                Node* index = node_new(parser->arena, NODE_INDEX);
                 index->data.index.bracket = true;
                 index->data.index.expr = node;
                 index->data.index.key = key;
@@ -292,7 +295,6 @@ Node* parser_secondaryexpr(
                 if (!lexer_istokentype(parser->lexer, TOK_IDENT))
                 {
                     parser_seterror(parser, "Right side of '%s' operation must be an identifier", class ? ".." : ".");
-                    node_free(node);
                     return NULL;
                 }
 
@@ -300,7 +302,6 @@ Node* parser_secondaryexpr(
                 Node* key = parser_stringorident(parser);
                 if (!key)
                 {
-                    node_free(node);
                     return NULL;
                 }
 
@@ -308,7 +309,7 @@ Node* parser_secondaryexpr(
                 key->type = NODE_STRING;
 
                 // Create the index node
-                Node* index = node_new(NODE_INDEX);
+                Node* index = node_new(parser->arena, NODE_INDEX);
                 index->data.index.bracket = false;
                 index->data.index.class = class;
                 index->data.index.expr = node;
@@ -323,10 +324,10 @@ Node* parser_secondaryexpr(
                 lexer_next(parser->lexer);
 
                 Node* expr = node;
-                Node* args = node_new(NODE_SEQUENCE);
+                Node* args = node_new(parser->arena, NODE_SEQUENCE);
 
                 // Create the invocation node
-                node = node_new(NODE_INVOCATION);
+                node = node_new(parser->arena, NODE_INVOCATION);
                 node->data.invocation.expr = expr;
                 node->data.invocation.args = args;
 
@@ -347,7 +348,7 @@ Node* parser_secondaryexpr(
                             args->data.sequence.expr = arg;
 
                             // Create the next node
-                            Node* next = node_new(NODE_SEQUENCE);
+                            Node* next = node_new(parser->arena, NODE_SEQUENCE);
                             args->data.sequence.next = next;
 
                             // Move to the next node
@@ -397,7 +398,6 @@ Node* parser_parenexpr(
     if (!lexer_istokentypeandid(parser->lexer, TOK_SYMBOL, ')'))
     {
         parser_seterror(parser, "Expected closing ')'");
-        node_free(expr);
         return NULL;
     }
 
@@ -443,7 +443,6 @@ Node* parser_binexpr(
         Node* rightexpr = parser_primaryexpr(parser);
         if (!rightexpr)
         {
-            node_free(leftexpr);
             return NULL;
         }
 
@@ -459,7 +458,6 @@ Node* parser_binexpr(
                 rightexpr = parser_binexpr(parser, opprec + 1, rightexpr);
                 if (!rightexpr)
                 {
-                    node_free(leftexpr);
                     return NULL;
                 }
             }
@@ -469,13 +467,11 @@ Node* parser_binexpr(
         if (op == OP_DEFINE && leftexpr->type != NODE_IDENT && !(leftexpr->type == NODE_INDEX && leftexpr->data.index.bracket == false))
         {
             parser_seterror(parser, "The left side of a ':=' expression must be an identifier");
-            node_free(leftexpr);
-            node_free(rightexpr);
             return NULL;
         }
 
         // Create the binary operation node
-        Node* binary = node_new(NODE_BINARY);
+        Node* binary = node_new(parser->arena, NODE_BINARY);
         binary->data.binary.op = op;
         binary->data.binary.leftexpr = leftexpr;
         binary->data.binary.rightexpr = rightexpr;
@@ -496,7 +492,7 @@ Node* parser_map(
 
     lexer_next(parser->lexer);
 
-    Node* maproot = node_new(NODE_MAP);
+    Node* maproot = node_new(parser->arena, NODE_MAP);
     if (lexer_istokentypeandid(parser->lexer, TOK_SYMBOL, '}'))
     {
         lexer_next(parser->lexer);
@@ -514,8 +510,6 @@ Node* parser_map(
     else if (!lexer_istokentypeandid(parser->lexer, TOK_SYMBOL, '}'))
     {
         parser_seterror(parser, "Expected closing '}'");
-        node_free(maproot);
-        node_free(exprs);
         return NULL;
     }
 
@@ -540,11 +534,11 @@ Node* parser_map(
         // Infer the key if it is not an association operation
         if (item->type != NODE_BINARY && item->data.binary.op != OP_ASSOC)
         {
-            Node* key = node_new(NODE_NUMBER);
+            Node* key = node_new(parser->arena, NODE_NUMBER);
             key->data.number.value = (double)i;
 
             // Create an association operation
-            Node* assoc = node_new(NODE_BINARY);
+            Node* assoc = node_new(parser->arena, NODE_BINARY);
             assoc->data.binary.op = OP_ASSOC;
             assoc->data.binary.leftexpr = key;
             assoc->data.binary.rightexpr = item;
@@ -557,7 +551,7 @@ Node* parser_map(
         expr = expr->data.sequence.next;
         if (expr)
         {
-            Node* nextmap = node_new(NODE_MAP);
+            Node* nextmap = node_new(parser->arena, NODE_MAP);
             nextmap->data.map.prev = map;
             map->data.map.next = nextmap;
             map = nextmap;
@@ -566,7 +560,6 @@ Node* parser_map(
         ++i;
     }
 
-    node_free(exprs);
     return maproot;
 }
 
@@ -584,20 +577,13 @@ Node* parser_function(
 
     LexerState state = lexer_savestate(parser->lexer);
 
-    Node* params = node_new(NODE_SEQUENCE);
+    Node* params = node_new(parser->arena, NODE_SEQUENCE);
     Node* param = params;
     for (;;)
     {
         Node* ident = parser_stringorident(parser);
         if (!ident || ident->type != NODE_IDENT)
         {
-            if (ident)
-            {
-                node_free(ident);
-                ident = NULL;
-            }
-
-            node_free(params);
             params = NULL;
 
             // Failed to parse the parametesr
@@ -612,7 +598,7 @@ Node* parser_function(
             break;
         }
 
-        param->data.sequence.next = node_new(NODE_SEQUENCE);
+        param->data.sequence.next = node_new(parser->arena, NODE_SEQUENCE);
         param = param->data.sequence.next;
     }
 
@@ -631,12 +617,11 @@ Node* parser_function(
     if (!lexer_istokentypeandid(parser->lexer, TOK_SYMBOL, ']'))
     {
         parser_seterror(parser, "Expected closing ']'");
-        node_free(exprs);
         return NULL;
     }
     lexer_next(parser->lexer);
 
-    Node* function = node_new(NODE_FUNCTION);
+    Node* function = node_new(parser->arena, NODE_FUNCTION);
     function->data.function.params = params;
     function->data.function.exprs = exprs;
     return function;
@@ -649,11 +634,11 @@ Node* parser_stringorident(
     Node* node;
     if (lexer_istokentype(parser->lexer, TOK_STRING))
     {
-        node = node_new(NODE_STRING);
+        node = node_new(parser->arena, NODE_STRING);
     }
     else if (lexer_istokentype(parser->lexer, TOK_IDENT))
     {
-        node = node_new(NODE_IDENT);
+        node = node_new(parser->arena, NODE_IDENT);
     }
     else
     {
@@ -663,9 +648,14 @@ Node* parser_stringorident(
 
     size_t length = lexer_gettokenlength(parser->lexer);
     const char* string = lexer_gettokenstring(parser->lexer);
-    StringId id = stringpool_getidsubstring(parser->stringpool, string, length);
+    Hash hash = lexer_gettokenhash(parser->lexer);
+    StringId id = stringpool_getidhashed(parser->stringpool, string, length, hash);
     node->data.string.id = id;
 
+    // Compiled code is never released so the strings it references are never
+    // collected
+    stringpool_pin(parser->stringpool, id);
+
     lexer_next(parser->lexer);
 
     return node;
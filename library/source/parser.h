@@ -30,12 +30,14 @@
 
 #define MAX_PARSER_ERROR_LENGTH (1024)
 #define MAX_PARSER_FULL_ERROR_LENGTH (2048)
+#define PARSER_ARENA_CHUNK_SIZE (16384)
 
 // A parser
 typedef struct Parser
 {
     Lexer*      lexer;
     StringPool* stringpool;
+    Arena*      arena;
     char        error[MAX_PARSER_ERROR_LENGTH];
     char        fullerror[MAX_PARSER_FULL_ERROR_LENGTH];
 } Parser;
@@ -46,7 +48,7 @@ Parser* parser_new(
     StringPool* stringpool
 );
 
-// Frees a parser
+// Frees a parser along with all of the nodes it has parsed
 void parser_free(
     Parser* parser
 );
@@ -0,0 +1,472 @@
+///////////////////////////////////////////////////////////////////////////////
+// This source file is part of Nominal.
+//
+// Copyright (c) 2015 Colin Hill
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////
+#include "peephole.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+// Emits an opcode to the output byte code array
+#define OPCODE(op)\
+    output[index++] = (uint32_t)op
+
+// Emits an operand to the output byte code array
+#define OPERAND(v)\
+    output[index++] = (uint32_t)(v)
+
+// The maximum number of jumps followed when threading a jump (guards against
+// cycles of jumps)
+#define PEEPHOLE_MAX_THREADING  (16)
+
+// A comparison fused with a conditional jump on its result
+typedef struct CompareBranch
+{
+    OpCode  compare;
+    OpCode  jumpif;
+    OpCode  jumpifnot;
+} CompareBranch;
+
+static const CompareBranch COMPAREBRANCHES[] =
+{
+    { OPCODE_EQ, OPCODE_JUMPIF_EQ, OPCODE_JUMPIFNOT_EQ },
+    { OPCODE_NE, OPCODE_JUMPIF_NE, OPCODE_JUMPIFNOT_NE },
+    { OPCODE_GT, OPCODE_JUMPIF_GT, OPCODE_JUMPIFNOT_GT },
+    { OPCODE_GTE, OPCODE_JUMPIF_GTE, OPCODE_JUMPIFNOT_GTE },
+    { OPCODE_LT, OPCODE_JUMPIF_LT, OPCODE_JUMPIFNOT_LT },
+    { OPCODE_LTE, OPCODE_JUMPIF_LTE, OPCODE_JUMPIFNOT_LTE }
+};
+
+// A pair of adjacent instructions executed as one superinstruction
+typedef struct Superinstruction
+{
+    OpCode  first;
+    OpCode  second;
+    OpCode  fused;
+} Superinstruction;
+
+// The superinstructions, chosen from the most frequently executed pairs of
+// adjacent instructions (see nom_dumpopcodepairs() and
+// tools/profile/opcodepairs.py)
+static const Superinstruction SUPERINSTRUCTIONS[] =
+{
+    { OPCODE_PUSH, OPCODE_FETCH, OPCODE_PUSH_FETCH },
+    { OPCODE_PUSH, OPCODE_FIND, OPCODE_PUSH_FIND },
+    { OPCODE_FETCH, OPCODE_FETCH, OPCODE_FETCH_FETCH },
+    { OPCODE_FETCH, OPCODE_CALL, OPCODE_FETCH_CALL },
+    { OPCODE_FETCH, OPCODE_ADD, OPCODE_FETCH_ADD },
+    { OPCODE_FETCH, OPCODE_SUB, OPCODE_FETCH_SUB },
+    { OPCODE_FETCH, OPCODE_LT, OPCODE_FETCH_LT },
+    { OPCODE_FETCH, OPCODE_LTE, OPCODE_FETCH_LTE }
+};
+
+static bool isjump(
+    OpCode  op
+);
+
+static int keptcondition(
+    OpCode  op
+);
+
+static bool matches(
+    const uint32_t*         bytecode,
+    const bool*             targets,
+    uint32_t                start,
+    uint32_t                end,
+    uint32_t                index,
+    OpCode                  op
+);
+
+static bool matchconditionaljump(
+    const uint32_t*         bytecode,
+    const bool*             targets,
+    uint32_t                start,
+    uint32_t                end,
+    uint32_t                index,
+    bool*                   negate,
+    uint32_t*               jumpif
+);
+
+static OpCode findcomparebranch(
+    OpCode  compare,
+    bool    negate
+);
+
+static OpCode findsuperinstruction(
+    OpCode  first,
+    OpCode  second
+);
+
+static uint32_t threadjump(
+    const uint32_t*         output,
+    uint32_t                start,
+    uint32_t                end,
+    OpCode                  op,
+    uint32_t                target
+);
+
+uint32_t peephole_optimize(
+    uint32_t*       bytecode,
+    uint32_t        start,
+    uint32_t        end
+)
+{
+    assert(bytecode);
+    assert(start <= end);
+
+    uint32_t length = end - start;
+    if (length == 0)
+    {
+        return end;
+    }
+
+    // Whether each word is the target of an instruction pointer
+    bool* targets = (bool*)calloc(length + 1, sizeof(bool));
+
+    // The new location of each instruction (relative to the start)
+    uint32_t* locations = (uint32_t*)malloc((length + 1) * sizeof(uint32_t));
+
+    // The rewritten code is never longer than the original code
+    uint32_t* output = (uint32_t*)malloc(length * sizeof(uint32_t));
+
+    assert(targets);
+    assert(locations);
+    assert(output);
+
+    for (uint32_t i = start; i < end; i += instructionlength(bytecode, i))
+    {
+        OpCode op = (OpCode)bytecode[i];
+        if (isjump(op) || op == OPCODE_FUNCTION)
+        {
+            uint32_t target = bytecode[i + 1];
+            if (target >= start && target <= end)
+            {
+                targets[target - start] = true;
+            }
+        }
+        else if (op == OPCODE_INLINE || op == OPCODE_GUARD_NUM)
+        {
+            // The entry of an inlined function is already the target of the
+            // FUNCTION instruction creating it
+            uint32_t target = bytecode[i + 2];
+            if (target >= start && target <= end)
+            {
+                targets[target - start] = true;
+            }
+        }
+    }
+
+    uint32_t index = 0;
+    uint32_t i = start;
+    while (i < end)
+    {
+        OpCode op = (OpCode)bytecode[i];
+        uint32_t next = i + instructionlength(bytecode, i);
+
+        locations[i - start] = index;
+
+        // EQ, DUP 0, NOT, JUMPIF -> JUMPIFNOT_EQ
+        // EQ, DUP 0, JUMPIF -> JUMPIF_EQ
+        // (and likewise for the other comparisons)
+        bool negate;
+        uint32_t jumpif;
+        if (matches(bytecode, targets, start, end, next, OPCODE_DUP) &&
+            matchconditionaljump(bytecode, targets, start, end, next, &negate, &jumpif))
+        {
+            OpCode fused = findcomparebranch(op, negate);
+            if (fused != OPCODE_INVALID)
+            {
+                for (uint32_t j = next; j <= jumpif; j += instructionlength(bytecode, j))
+                {
+                    locations[j - start] = index;
+                }
+
+                OPCODE(fused);
+                OPERAND(bytecode[jumpif + 1]);
+                i = jumpif + instructionlength(bytecode, jumpif);
+                continue;
+            }
+        }
+
+        // DUP 0, NOT, JUMPIF -> JUMPIFNOT_KEEP
+        // DUP 0, JUMPIF -> JUMPIF_KEEP
+        if (matchconditionaljump(bytecode, targets, start, end, i, &negate, &jumpif))
+        {
+            for (uint32_t j = next; j <= jumpif; j += instructionlength(bytecode, j))
+            {
+                locations[j - start] = index;
+            }
+
+            OPCODE(negate ? OPCODE_JUMPIFNOT_KEEP : OPCODE_JUMPIF_KEEP);
+            OPERAND(bytecode[jumpif + 1]);
+            i = jumpif + instructionlength(bytecode, jumpif);
+            continue;
+        }
+
+        // DEFINE, POP -> DEFINE_DROP
+        // ASSIGN, POP -> ASSIGN_DROP
+        if ((op == OPCODE_DEFINE || op == OPCODE_ASSIGN) && matches(bytecode, targets, start, end, next, OPCODE_POP))
+        {
+            locations[next - start] = index;
+            OPCODE(op == OPCODE_DEFINE ? OPCODE_DEFINE_DROP : OPCODE_ASSIGN_DROP);
+            OPERAND(bytecode[i + 1]);
+            i = next + 1;
+            continue;
+        }
+
+        // PUSH, POP -> (nothing)
+        if (op == OPCODE_PUSH && matches(bytecode, targets, start, end, next, OPCODE_POP))
+        {
+            locations[next - start] = index;
+            i = next + 1;
+            continue;
+        }
+
+        // Fuse a pair of instructions into a superinstruction taking the
+        // operands of both
+        if (next < end && !targets[next - start])
+        {
+            OpCode fused = findsuperinstruction(op, (OpCode)bytecode[next]);
+            if (fused != OPCODE_INVALID)
+            {
+                uint32_t after = next + instructionlength(bytecode, next);
+                locations[next - start] = index;
+                OPCODE(fused);
+                memcpy(&output[index], &bytecode[i + 1], (next - i - 1) * sizeof(uint32_t));
+                index += next - i - 1;
+                memcpy(&output[index], &bytecode[next + 1], (after - next - 1) * sizeof(uint32_t));
+                index += after - next - 1;
+                i = after;
+                continue;
+            }
+        }
+
+        memcpy(&output[index], &bytecode[i], (next - i) * sizeof(uint32_t));
+        index += next - i;
+        i = next;
+    }
+    locations[length] = index;
+
+    // Remap the instruction pointers to the new locations of their targets
+    for (uint32_t j = 0; j < index; j += instructionlength(output, j))
+    {
+        OpCode op = (OpCode)output[j];
+        if (isjump(op) || op == OPCODE_FUNCTION || op == OPCODE_INLINE)
+        {
+            uint32_t target = output[j + 1];
+            if (target >= start && target <= end)
+            {
+                output[j + 1] = start + locations[target - start];
+            }
+        }
+
+        if (op == OPCODE_INLINE || op == OPCODE_GUARD_NUM)
+        {
+            uint32_t target = output[j + 2];
+            if (target >= start && target <= end)
+            {
+                output[j + 2] = start + locations[target - start];
+            }
+        }
+    }
+
+    // Thread jumps which land on other jumps
+    for (uint32_t j = 0; j < index; j += instructionlength(output, j))
+    {
+        OpCode op = (OpCode)output[j];
+        if (isjump(op))
+        {
+            uint32_t target = output[j + 1];
+            output[j + 1] = threadjump(output, start, start + index, op, target);
+        }
+    }
+
+    memcpy(&bytecode[start], output, index * sizeof(uint32_t));
+
+    free(output);
+    free(locations);
+    free(targets);
+
+    return start + index;
+}
+
+static bool isjump(
+    OpCode  op
+)
+{
+    return op == OPCODE_JUMP
+        || op == OPCODE_JUMPIF
+        || keptcondition(op) != 0;
+}
+
+static int keptcondition(
+    OpCode  op
+)
+{
+    // Returns 1 for a jump taken when the value it leaves on the stack is
+    // true, -1 for a jump taken when the value is not true, and 0 otherwise
+    if (op == OPCODE_JUMPIF_KEEP)
+    {
+        return 1;
+    }
+    else if (op == OPCODE_JUMPIFNOT_KEEP)
+    {
+        return -1;
+    }
+
+    size_t count = sizeof(COMPAREBRANCHES) / sizeof(COMPAREBRANCHES[0]);
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (COMPAREBRANCHES[i].jumpif == op)
+        {
+            return 1;
+        }
+        else if (COMPAREBRANCHES[i].jumpifnot == op)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static bool matches(
+    const uint32_t*         bytecode,
+    const bool*             targets,
+    uint32_t                start,
+    uint32_t                end,
+    uint32_t                index,
+    OpCode                  op
+)
+{
+    // An instruction which is jumped to cannot be fused with the instruction
+    // before it
+    return index < end && !targets[index - start] && bytecode[index] == op;
+}
+
+static bool matchconditionaljump(
+    const uint32_t*         bytecode,
+    const bool*             targets,
+    uint32_t                start,
+    uint32_t                end,
+    uint32_t                index,
+    bool*                   negate,
+    uint32_t*               jumpif
+)
+{
+    // Matches the code testing a value for and/or (DUP 0, optionally NOT,
+    // then JUMPIF) starting at an index
+    if (bytecode[index] != OPCODE_DUP || bytecode[index + 1] != 0)
+    {
+        return false;
+    }
+
+    uint32_t j = index + instructionlength(bytecode, index);
+    *negate = matches(bytecode, targets, start, end, j, OPCODE_NOT);
+    if (*negate)
+    {
+        ++j;
+    }
+
+    if (!matches(bytecode, targets, start, end, j, OPCODE_JUMPIF))
+    {
+        return false;
+    }
+
+    *jumpif = j;
+    return true;
+}
+
+static OpCode findcomparebranch(
+    OpCode  compare,
+    bool    negate
+)
+{
+    size_t count = sizeof(COMPAREBRANCHES) / sizeof(COMPAREBRANCHES[0]);
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (COMPAREBRANCHES[i].compare == compare)
+        {
+            return negate ? COMPAREBRANCHES[i].jumpifnot : COMPAREBRANCHES[i].jumpif;
+        }
+    }
+
+    return OPCODE_INVALID;
+}
+
+static OpCode findsuperinstruction(
+    OpCode  first,
+    OpCode  second
+)
+{
+    size_t count = sizeof(SUPERINSTRUCTIONS) / sizeof(SUPERINSTRUCTIONS[0]);
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (SUPERINSTRUCTIONS[i].first == first && SUPERINSTRUCTIONS[i].second == second)
+        {
+            return SUPERINSTRUCTIONS[i].fused;
+        }
+    }
+
+    return OPCODE_INVALID;
+}
+
+static uint32_t threadjump(
+    const uint32_t*         output,
+    uint32_t                start,
+    uint32_t                end,
+    OpCode                  op,
+    uint32_t                target
+)
+{
+    for (int hops = 0; hops < PEEPHOLE_MAX_THREADING; ++hops)
+    {
+        if (target < start || target >= end)
+        {
+            break;
+        }
+
+        // Only JUMPIF_KEEP/JUMPIFNOT_KEEP test the value left by the jump
+        // (the fused comparisons test values of their own)
+        OpCode next = (OpCode)output[target - start];
+        int condition = keptcondition(op);
+        int nextcondition = next == OPCODE_JUMPIF_KEEP || next == OPCODE_JUMPIFNOT_KEEP ? keptcondition(next) : 0;
+        if (next == OPCODE_JUMP || (condition != 0 && nextcondition == condition))
+        {
+            // An unconditional jump, or a conditional jump on the same kept
+            // value with the same condition, is always taken
+            target = output[target - start + 1];
+        }
+        else if (condition != 0 && nextcondition == -condition)
+        {
+            // A conditional jump on the same kept value with the opposite
+            // condition is never taken
+            target += instructionlength(output, target - start);
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    return target;
+}
@@ -0,0 +1,43 @@
+///////////////////////////////////////////////////////////////////////////////
+// This source file is part of Nominal.
+//
+// Copyright (c) 2015 Colin Hill
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include "codegen.h"
+
+// Rewrites the byte code from start to end in place, fusing common
+// instruction sequences and pairs into superinstructions, threading jumps to
+// jumps, and removing instructions with no effect; returns the index where
+// the optimized byte code ends
+//
+// Only sequences which nothing jumps into the middle of are rewritten, and
+// the absolute instruction pointers within the range are remapped to the new
+// locations of their targets
+uint32_t peephole_optimize(
+    uint32_t*       bytecode,
+    uint32_t        start,
+    uint32_t        end
+);
+
+#endif
@@ -396,6 +396,219 @@ static NomValue prelude_object(
     return object;
 }
 
+static NomValue prelude_join(
+    NomState*   state
+)
+{
+    assert(state);
+
+    NomValue values = nom_getarg(state, 0);
+    NomValue separator = nom_getarg(state, 1);
+
+    if (!nom_isiterable(state, values))
+    {
+        nom_seterror(state, "'values' is not iterable");
+        return nom_nil();
+    }
+
+    if (!nom_isnil(separator) && !nom_isstring(state, separator))
+    {
+        nom_seterror(state, "'separator' is not a String");
+        return nom_nil();
+    }
+
+    // Concatenate each value with the separator between them
+    NomValue result = nom_newstring(state, "");
+    bool first = true;
+
+    NomIterator iterator = { 0 };
+    while (nom_next(state, values, &iterator))
+    {
+        if (!nom_isstring(state, iterator.value))
+        {
+            nom_seterror(state, "'values' contains a value which is not a String");
+            return nom_nil();
+        }
+
+        if (!first && !nom_isnil(separator))
+        {
+            result = string_concat(state, result, separator);
+        }
+
+        result = string_concat(state, result, iterator.value);
+        first = false;
+    }
+
+    return result;
+}
+
+// Gets an optional index argument, returning false and setting an error if
+// the argument is not a valid index
+static bool getindexarg(
+    NomState*   state,
+    size_t      index,
+    const char* name,
+    size_t      defaultvalue,
+    size_t*     value
+)
+{
+    assert(state);
+    assert(name);
+    assert(value);
+
+    NomValue arg = nom_getarg(state, index);
+    if (nom_isnil(arg))
+    {
+        *value = defaultvalue;
+    }
+    else if (nom_isnumber(arg) && nom_todouble(arg) >= 0)
+    {
+        *value = nom_tosize(arg);
+    }
+    else
+    {
+        nom_seterror(state, "'%s' is not a valid index", name);
+        return false;
+    }
+
+    return true;
+}
+
+static NomValue prelude_slice(
+    NomState*   state
+)
+{
+    assert(state);
+
+    NomValue string = nom_getarg(state, 0);
+    if (!nom_isstring(state, string))
+    {
+        nom_seterror(state, "'string' is not a String");
+        return nom_nil();
+    }
+
+    size_t length = string_getlength(state, string);
+
+    size_t start;
+    size_t end;
+    if (!getindexarg(state, 1, "start", 0, &start) ||
+            !getindexarg(state, 2, "end", length, &end))
+    {
+        return nom_nil();
+    }
+
+    if (start > end || end > length)
+    {
+        nom_seterror(state, "Slice %u to %u is out of range", (unsigned)start, (unsigned)end);
+        return nom_nil();
+    }
+
+    NomValue result = string_slice(state, string, start, end - start);
+    return result;
+}
+
+static NomValue prelude_find(
+    NomState*   state
+)
+{
+    assert(state);
+
+    NomValue string = nom_getarg(state, 0);
+    NomValue substring = nom_getarg(state, 1);
+    if (!nom_isstring(state, string))
+    {
+        nom_seterror(state, "'string' is not a String");
+        return nom_nil();
+    }
+    else if (!nom_isstring(state, substring))
+    {
+        nom_seterror(state, "'substring' is not a String");
+        return nom_nil();
+    }
+
+    size_t start;
+    if (!getindexarg(state, 2, "start", 0, &start))
+    {
+        return nom_nil();
+    }
+
+    NomValue result = nom_nil();
+
+    size_t index;
+    if (string_find(state, string, substring, start, &index))
+    {
+        result = nom_fromsize(index);
+    }
+
+    return result;
+}
+
+static NomValue prelude_split(
+    NomState*   state
+)
+{
+    assert(state);
+
+    NomValue string = nom_getarg(state, 0);
+    NomValue separator = nom_getarg(state, 1);
+    if (!nom_isstring(state, string))
+    {
+        nom_seterror(state, "'string' is not a String");
+        return nom_nil();
+    }
+    else if (!nom_isstring(state, separator) || string_getlength(state, separator) == 0)
+    {
+        nom_seterror(state, "'separator' is not a non-empty String");
+        return nom_nil();
+    }
+
+    size_t length = string_getlength(state, string);
+    size_t separatorlength = string_getlength(state, separator);
+
+    // Each part is a view of the string
+    NomValue parts = nom_newmap(state);
+    size_t count = 0;
+    size_t start = 0;
+    size_t index;
+    while (string_find(state, string, separator, start, &index))
+    {
+        NomValue part = string_slice(state, string, start, index - start);
+        map_insert(state, parts, nom_fromsize(count++), part);
+        start = index + separatorlength;
+    }
+
+    NomValue part = string_slice(state, string, start, length - start);
+    map_insert(state, parts, nom_fromsize(count), part);
+
+    return parts;
+}
+
+static NomValue prelude_remove(
+    NomState*   state
+)
+{
+    assert(state);
+
+    NomValue result = nom_nil();
+
+    NomValue map = nom_getarg(state, 0);
+    NomValue key = nom_getarg(state, 1);
+    if (nom_ismap(state, map))
+    {
+        // Return the value that was removed (or nil if there was none)
+        if (map_find(state, map, key, &result))
+        {
+            map_remove(state, map, key);
+        }
+    }
+    else
+    {
+        nom_seterror(state, "'map' is not a Map");
+    }
+
+    return result;
+}
+
 void import_prelude(
     NomState*   state
 )
@@ -466,4 +679,29 @@ void import_prelude(
     {
         nom_letvar(state, "object", nom_newfunction(state, prelude_object));
     }
+
+    if (!nom_error(state))
+    {
+        nom_letvar(state, "join", nom_newfunction(state, prelude_join));
+    }
+
+    if (!nom_error(state))
+    {
+        nom_letvar(state, "slice", nom_newfunction(state, prelude_slice));
+    }
+
+    if (!nom_error(state))
+    {
+        nom_letvar(state, "find", nom_newfunction(state, prelude_find));
+    }
+
+    if (!nom_error(state))
+    {
+        nom_letvar(state, "split", nom_newfunction(state, prelude_split));
+    }
+
+    if (!nom_error(state))
+    {
+        nom_letvar(state, "remove", nom_newfunction(state, prelude_remove));
+    }
 }
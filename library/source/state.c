@@ -29,6 +29,8 @@
 #include "parser.h"
 #include "prelude.h"
 #include "codegen.h"
+#include "compiler.h"
+#include "peephole.h"
 #include "string.h"
 
 #include <assert.h>
@@ -71,9 +73,154 @@
 #define PEEK_VALUE(n)\
     state->stack[state->sp - 1 - (n)]
 
-// Reads the a typed value from the byte code at the current instruction
-#define READAS(t)\
-    *(t*)&state->bytecode[state->ip]; state->ip += sizeof(t)
+// Reads the next operand of the current instruction
+#define READ()\
+    state->bytecode[state->ip++]
+
+// Reads the constant referenced by the next operand of the current instruction
+#define READCONSTANT()\
+    state->constants.values[state->bytecode[state->ip++]]
+
+// Compares two values as numbers (without converting them if they are already
+// numbers)
+#define COMPARE(l, cmp, r)\
+    (IS_NUMBER(l) && IS_NUMBER(r) ? (l).number cmp (r).number : nom_todouble(l) cmp nom_todouble(r))
+
+// Counts the instruction about to be executed when profiling opcode pairs
+#ifdef NOM_OPCODE_PROFILE
+#define PROFILE_INSTRUCTION()\
+    profileinstruction(state)
+#else
+#define PROFILE_INSTRUCTION()
+#endif
+
+// When the compiler supports computed gotos, each function is decoded the first
+// time it is executed into instructions holding the address of their handler
+// and their operands, and instructions are dispatched by jumping directly to
+// their handler; otherwise the byte code is interpreted through a switch
+#if defined(NOM_THREADED_DISPATCH) && defined(__GNUC__)
+#define THREADED_DISPATCH
+#endif
+
+#ifdef THREADED_DISPATCH
+
+// Labels the handler of an opcode as both a switch case and a jump target
+#define OPERATION(o)\
+    case o: label_##o
+
+// Fetches the decoded instruction at the instruction pointer and moves the
+// instruction pointer past it
+#define DECODE()\
+    start = state->ip;\
+    instruction = &state->decoded[start];\
+    assert(instruction->handler);\
+    op = (OpCode)instruction->opcode;\
+    state->ip = instruction->next;\
+    operand = 0
+
+// Ends the handler of an instruction by fetching the next instruction and
+// jumping directly to its handler, which gives each handler its own indirect
+// branch to predict; falls back to the loop when execution should stop
+#define NEXT()\
+    if (state->ip == endip || state->errorflag || stop)\
+    {\
+        break;\
+    }\
+    PROFILE_INSTRUCTION();\
+    DECODE();\
+    goto *instruction->handler
+
+// Reads the next decoded operand of the current instruction
+#define OPERAND()\
+    instruction->operands[operand++]
+
+// Reads the decoded constant referenced by the next operand of the current
+// instruction
+#define OPERAND_CONSTANT()\
+    (++operand, instruction->constant)
+
+// Reads the inline cache referenced by the next operand of the current
+// instruction
+#define OPERAND_CACHE()\
+    (++operand, readinlinecache(state, &state->bytecode[start + operand], &instruction->operands[operand - 1]))
+
+// Reads the next parameter of a function instruction (which are not decoded)
+#define OPERAND_PARAMETER()\
+    state->bytecode[start + 1 + operand++]
+
+// Rewrites the opcode of the instruction being executed in both the byte code
+// and the decoded instruction
+#define QUICKEN(o)\
+    state->bytecode[start] = (uint32_t)o;\
+    instruction->opcode = (uint32_t)o;\
+    instruction->handler = dispatchtable[o]
+
+// Decodes the function at the instruction pointer if it has not been decoded
+// yet
+#define TRANSLATE()\
+    if (state->ip < state->end && (!state->decoded || !state->decoded[state->ip].handler))\
+    {\
+        translate(state, dispatchtable, state->ip);\
+    }
+
+#else
+
+// Labels the handler of an opcode as a switch case
+#define OPERATION(o)\
+    case o
+
+// Reads the opcode at the instruction pointer and moves the instruction
+// pointer to its first operand
+#define DECODE()\
+    start = state->ip;\
+    op = (OpCode)state->bytecode[state->ip++]
+
+// Ends the handler of an instruction
+#define NEXT()\
+    break
+
+// Operands are read straight from the byte code
+#define OPERAND()\
+    READ()
+
+#define OPERAND_CONSTANT()\
+    READCONSTANT()
+
+#define OPERAND_CACHE()\
+    readinlinecache(state, &state->bytecode[state->ip++], NULL)
+
+#define OPERAND_PARAMETER()\
+    READ()
+
+// Rewrites the opcode of the instruction being executed
+#define QUICKEN(o)\
+    state->bytecode[start] = (uint32_t)o
+
+// Byte code is interpreted as is
+#define TRANSLATE()
+
+#endif
+
+#ifdef NOM_OPCODE_PROFILE
+
+// The execution count of a pair of adjacent instructions
+typedef struct OpCodePair
+{
+    uint64_t    count;
+    OpCode      first;
+    OpCode      second;
+} OpCodePair;
+
+static void profileinstruction(
+    NomState*   state
+);
+
+static int compareopcodepairs(
+    const void* a,
+    const void* b
+);
+
+#endif
 
 static void compile(
     NomState*   state,
@@ -90,11 +237,34 @@ static void call(
     bool        execute
 );
 
+static void invoke(
+    NomState*   state,
+    NomValue    function,
+    uint8_t     argcount,
+    bool        execute
+);
+
 static void mark(
     NomState*   state,
     NomValue    value
 );
 
+static InlineCache* readinlinecache(
+    NomState*   state,
+    uint32_t*   operand,
+    uint32_t*   decoded
+);
+
+#ifdef THREADED_DISPATCH
+
+static void translate(
+    NomState*           state,
+    void* const*        handlers,
+    uint32_t            ip
+);
+
+#endif
+
 NomState* nom_newstate(
     void
 )
@@ -106,6 +276,12 @@ NomState* nom_newstate(
 
     state->cp = 1;
     state->heap = heap_new();
+
+#ifdef NOM_OPCODE_PROFILE
+    state->opcodepairs = (uint64_t*)calloc(OPCODE_COUNT * OPCODE_COUNT, sizeof(uint64_t));
+    state->lastopcode = OPCODE_INVALID;
+#endif
+
     state->stringpool = stringpool_new(STATE_STRING_POOL_SIZE);
 
     // Define intrinsic global variables
@@ -121,6 +297,14 @@ NomState* nom_newstate(
     state->strings.multiply = nom_newinternedstring(state, "multiply");
     state->strings.divide = nom_newinternedstring(state, "divide");
 
+    // Keep the intrinsic strings from being collected
+    nom_acquire(state, state->strings.name);
+    nom_acquire(state, state->strings.new);
+    nom_acquire(state, state->strings.add);
+    nom_acquire(state, state->strings.subtract);
+    nom_acquire(state, state->strings.multiply);
+    nom_acquire(state, state->strings.divide);
+
     // Define the intrinsic class map
     state->classes.class = nom_newmap(state);
     nom_insert(state, state->classes.class, state->strings.name, nom_newinternedstring(state, "Class"));
@@ -134,6 +318,7 @@ NomState* nom_newstate(
     state->classes.string = state_newclass(state, "String");
     state->classes.map = state_newclass(state, "Map");
     state->classes.function = state_newclass(state, "Function");
+    state->classes.bytes = state_newclass(state, "Bytes");
     state->classes.module = state_newclass(state, "Module");
 
     // Import the prelude library
@@ -163,6 +348,28 @@ void nom_freestate(
         heap_free(state->heap);
     }
 
+    // Free the inline caches
+    if (state->inlinecaches)
+    {
+        free(state->inlinecaches);
+    }
+
+    // Free the constant pool
+    if (state->constants.values)
+    {
+        free(state->constants.values);
+    }
+
+    // Free the decoded instructions
+    if (state->decoded)
+    {
+        free(state->decoded);
+    }
+
+#ifdef NOM_OPCODE_PROFILE
+    free(state->opcodepairs);
+#endif
+
     free(state);
 }
 
@@ -415,7 +622,7 @@ void nom_dumpbytecode(
         {
         case OPCODE_PUSH:
         {
-            NomValue value = READAS(NomValue);
+            NomValue value = READCONSTANT();
             char buffer[256];
             nom_tostring(state, buffer, 256, value);
             printf("%s", buffer);
@@ -424,7 +631,7 @@ void nom_dumpbytecode(
 
         case OPCODE_DUP:
         {
-            uint32_t index = READAS(uint32_t);
+            uint32_t index = READ();
             printf("%u", index);
         }
         break;
@@ -432,28 +639,77 @@ void nom_dumpbytecode(
         case OPCODE_DEFINE:
         case OPCODE_FETCH:
         case OPCODE_ASSIGN:
+        case OPCODE_DEFINE_DROP:
+        case OPCODE_ASSIGN_DROP:
+        case OPCODE_FETCH_ADD:
+        case OPCODE_FETCH_SUB:
+        case OPCODE_FETCH_LT:
+        case OPCODE_FETCH_LTE:
+        case OPCODE_FETCH_ADD_NUM:
+        case OPCODE_FETCH_SUB_NUM:
+        case OPCODE_FETCH_LT_NUM:
+        case OPCODE_FETCH_LTE_NUM:
         {
-            StringId id = READAS(StringId);
+            StringId id = READ();
             const char* string = stringpool_find(state->stringpool, id);
             printf("%s", string);
         }
         break;
 
+        case OPCODE_FETCH_FETCH:
+        {
+            StringId first = READ();
+            StringId second = READ();
+            printf("%s %s", stringpool_find(state->stringpool, first), stringpool_find(state->stringpool, second));
+        }
+        break;
+
+        case OPCODE_PUSH_FETCH:
+        case OPCODE_PUSH_FIND:
+        {
+            NomValue value = READCONSTANT();
+            char buffer[256];
+            nom_tostring(state, buffer, 256, value);
+            printf("%s ", buffer);
+
+            uint32_t operand = READ();
+            if (op == OPCODE_PUSH_FETCH)
+            {
+                printf("%s", stringpool_find(state->stringpool, (StringId)operand));
+            }
+            else if (operand != INLINE_CACHE_NONE)
+            {
+                printf("#%u", operand);
+            }
+        }
+        break;
+
+        case OPCODE_FIND:
+        case OPCODE_GET:
+        {
+            uint32_t cacheindex = READ();
+            if (cacheindex != INLINE_CACHE_NONE)
+            {
+                printf("#%u", cacheindex);
+            }
+        }
+        break;
+
         case OPCODE_MAP:
         {
-            uint32_t itemCount = READAS(uint32_t);
+            uint32_t itemCount = READ();
             printf("\t%u", itemCount);
         }
         break;
 
         case OPCODE_FUNCTION:
         {
-            uint32_t ip = READAS(uint32_t);
-            uint32_t paramcount = READAS(uint32_t);
+            uint32_t ip = READ();
+            uint32_t paramcount = READ();
             printf("0x%08x %u ", ip, paramcount);
             for (uint32_t i = 0; i < paramcount; ++i)
             {
-                StringId id = READAS(StringId);
+                StringId id = READ();
                 const char* param = stringpool_find(state->stringpool, id);
                 printf("%s", param);
                 if (i < paramcount - 1)
@@ -466,19 +722,60 @@ void nom_dumpbytecode(
 
         case OPCODE_JUMP:
         case OPCODE_JUMPIF:
+        case OPCODE_JUMPIF_KEEP:
+        case OPCODE_JUMPIFNOT_KEEP:
+        case OPCODE_JUMPIF_EQ:
+        case OPCODE_JUMPIFNOT_EQ:
+        case OPCODE_JUMPIF_NE:
+        case OPCODE_JUMPIFNOT_NE:
+        case OPCODE_JUMPIF_GT:
+        case OPCODE_JUMPIFNOT_GT:
+        case OPCODE_JUMPIF_GTE:
+        case OPCODE_JUMPIFNOT_GTE:
+        case OPCODE_JUMPIF_LT:
+        case OPCODE_JUMPIFNOT_LT:
+        case OPCODE_JUMPIF_LTE:
+        case OPCODE_JUMPIFNOT_LTE:
         {
-            uint32_t ip = READAS(uint32_t);
+            uint32_t ip = READ();
             printf("0x%08x", ip);
         }
         break;
 
         case OPCODE_CALL:
+        case OPCODE_SLIDE:
         {
-            uint32_t argcount = READAS(uint32_t);
+            uint32_t argcount = READ();
             printf("%u", argcount);
         }
         break;
 
+        case OPCODE_INLINE:
+        {
+            uint32_t ip = READ();
+            uint32_t callip = READ();
+            printf("0x%08x 0x%08x", ip, callip);
+        }
+        break;
+
+        case OPCODE_GUARD_NUM:
+        {
+            uint32_t count = READ();
+            uint32_t callip = READ();
+            printf("%u 0x%08x", count, callip);
+        }
+        break;
+
+        case OPCODE_CALL_METHOD:
+        case OPCODE_FETCH_CALL:
+        {
+            StringId id = READ();
+            uint32_t argcount = READ();
+            const char* selector = stringpool_find(state->stringpool, id);
+            printf("%s %u", selector, argcount);
+        }
+        break;
+
         default:
             break;
         }
@@ -489,6 +786,50 @@ void nom_dumpbytecode(
     state->ip = current_ip;
 }
 
+void nom_dumpopcodepairs(
+    NomState*   state
+)
+{
+    assert(state);
+
+#ifdef NOM_OPCODE_PROFILE
+    // Gather the pairs which were executed
+    OpCodePair* pairs = (OpCodePair*)malloc(OPCODE_COUNT * OPCODE_COUNT * sizeof(OpCodePair));
+    assert(pairs);
+
+    size_t paircount = 0;
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < OPCODE_COUNT * OPCODE_COUNT; ++i)
+    {
+        if (state->opcodepairs[i] > 0)
+        {
+            pairs[paircount].count = state->opcodepairs[i];
+            pairs[paircount].first = (OpCode)(i / OPCODE_COUNT);
+            pairs[paircount].second = (OpCode)(i % OPCODE_COUNT);
+            total += pairs[paircount].count;
+            ++paircount;
+        }
+    }
+
+    qsort(pairs, paircount, sizeof(OpCodePair), compareopcodepairs);
+
+    printf("Opcode pairs (%llu executed):\n", (unsigned long long)total);
+    for (size_t i = 0; i < paircount; ++i)
+    {
+        printf("%12llu %6.2f%%  %s %s\n",
+            (unsigned long long)pairs[i].count,
+            100.0 * (double)pairs[i].count / (double)total,
+            OPCODE_NAMES[pairs[i].first],
+            OPCODE_NAMES[pairs[i].second]);
+    }
+
+    free(pairs);
+#else
+    (void)state;
+    printf("Opcode profiling is not enabled (configure with -DNOM_OPCODE_PROFILE=ON)\n");
+#endif
+}
+
 void nom_dumpstack(NomState* state)
 {
     printf("Stack:\n");
@@ -565,6 +906,21 @@ int nom_collectgarbage(
     // Sweep
     unsigned int count = heap_sweep(state->heap);
 
+    // Sweep the interned strings which are not referenced by any live value
+    size_t stringcount = stringpool_sweep(state->stringpool);
+    if (stringcount > 0)
+    {
+        // The IDs of the collected strings may be reused so forget any cached
+        // lookups which remember a string
+        if (state->inlinecaches)
+        {
+            memset(state->inlinecaches, 0, sizeof(InlineCache) * state->inlinecachecount);
+        }
+        memset(state->methodcache, 0, sizeof(state->methodcache));
+
+        count += (unsigned int)stringcount;
+    }
+
     return count;
 }
 
@@ -687,14 +1043,18 @@ NomValue state_call(
         PUSH_VALUE(args[i]);
     }
 
-    PUSH_VALUE(value);
-
-    call(state, argcount, true);
+    invoke(state, value, argcount, true);
 
     NomValue result = POP_VALUE();
     return result;
 }
 
+#ifdef THREADED_DISPATCH
+// Taking the address of a label and jumping to it are GNU extensions
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
 void state_execute(
     NomState*   state
 )
@@ -706,10 +1066,98 @@ void state_execute(
 
     StringId id;
     NomValue l, r, result;
+    InlineCache* cache;
     OpCode op;
-    uint32_t count, ip;
+    uint32_t count, ip, start;
+    bool condition;
     bool stop = false;
 
+#ifdef THREADED_DISPATCH
+    // The address of the handler of each opcode (must list every opcode)
+    static void* const dispatchtable[] =
+    {
+        [OPCODE_PUSH] = &&label_OPCODE_PUSH,
+        [OPCODE_POP] = &&label_OPCODE_POP,
+        [OPCODE_DUP] = &&label_OPCODE_DUP,
+        [OPCODE_ADD] = &&label_OPCODE_ADD,
+        [OPCODE_SUB] = &&label_OPCODE_SUB,
+        [OPCODE_MUL] = &&label_OPCODE_MUL,
+        [OPCODE_DIV] = &&label_OPCODE_DIV,
+        [OPCODE_NEG] = &&label_OPCODE_NEG,
+        [OPCODE_EQ] = &&label_OPCODE_EQ,
+        [OPCODE_NE] = &&label_OPCODE_NE,
+        [OPCODE_GT] = &&label_OPCODE_GT,
+        [OPCODE_GTE] = &&label_OPCODE_GTE,
+        [OPCODE_LT] = &&label_OPCODE_LT,
+        [OPCODE_LTE] = &&label_OPCODE_LTE,
+        [OPCODE_AND] = &&label_OPCODE_AND,
+        [OPCODE_OR] = &&label_OPCODE_OR,
+        [OPCODE_NOT] = &&label_OPCODE_NOT,
+        [OPCODE_DEFINE] = &&label_OPCODE_DEFINE,
+        [OPCODE_ASSIGN] = &&label_OPCODE_ASSIGN,
+        [OPCODE_DEFINE_DROP] = &&label_OPCODE_DEFINE_DROP,
+        [OPCODE_ASSIGN_DROP] = &&label_OPCODE_ASSIGN_DROP,
+        [OPCODE_FETCH] = &&label_OPCODE_FETCH,
+        [OPCODE_INSERT] = &&label_OPCODE_INSERT,
+        [OPCODE_UPDATE] = &&label_OPCODE_UPDATE,
+        [OPCODE_FIND] = &&label_OPCODE_FIND,
+        [OPCODE_GET] = &&label_OPCODE_GET,
+        [OPCODE_SET] = &&label_OPCODE_SET,
+        [OPCODE_MAP] = &&label_OPCODE_MAP,
+        [OPCODE_FUNCTION] = &&label_OPCODE_FUNCTION,
+        [OPCODE_CLASSOF] = &&label_OPCODE_CLASSOF,
+        [OPCODE_JUMP] = &&label_OPCODE_JUMP,
+        [OPCODE_JUMPIF] = &&label_OPCODE_JUMPIF,
+        [OPCODE_JUMPIF_KEEP] = &&label_OPCODE_JUMPIF_KEEP,
+        [OPCODE_JUMPIFNOT_KEEP] = &&label_OPCODE_JUMPIFNOT_KEEP,
+        [OPCODE_JUMPIF_EQ] = &&label_OPCODE_JUMPIF_EQ,
+        [OPCODE_JUMPIFNOT_EQ] = &&label_OPCODE_JUMPIFNOT_EQ,
+        [OPCODE_JUMPIF_NE] = &&label_OPCODE_JUMPIF_NE,
+        [OPCODE_JUMPIFNOT_NE] = &&label_OPCODE_JUMPIFNOT_NE,
+        [OPCODE_JUMPIF_GT] = &&label_OPCODE_JUMPIF_GT,
+        [OPCODE_JUMPIFNOT_GT] = &&label_OPCODE_JUMPIFNOT_GT,
+        [OPCODE_JUMPIF_GTE] = &&label_OPCODE_JUMPIF_GTE,
+        [OPCODE_JUMPIFNOT_GTE] = &&label_OPCODE_JUMPIFNOT_GTE,
+        [OPCODE_JUMPIF_LT] = &&label_OPCODE_JUMPIF_LT,
+        [OPCODE_JUMPIFNOT_LT] = &&label_OPCODE_JUMPIFNOT_LT,
+        [OPCODE_JUMPIF_LTE] = &&label_OPCODE_JUMPIF_LTE,
+        [OPCODE_JUMPIFNOT_LTE] = &&label_OPCODE_JUMPIFNOT_LTE,
+        [OPCODE_CALL] = &&label_OPCODE_CALL,
+        [OPCODE_CALL_METHOD] = &&label_OPCODE_CALL_METHOD,
+        [OPCODE_RET] = &&label_OPCODE_RET,
+        [OPCODE_INLINE] = &&label_OPCODE_INLINE,
+        [OPCODE_GUARD_NUM] = &&label_OPCODE_GUARD_NUM,
+        [OPCODE_SLIDE] = &&label_OPCODE_SLIDE,
+        [OPCODE_PUSH_FETCH] = &&label_OPCODE_PUSH_FETCH,
+        [OPCODE_PUSH_FIND] = &&label_OPCODE_PUSH_FIND,
+        [OPCODE_FETCH_FETCH] = &&label_OPCODE_FETCH_FETCH,
+        [OPCODE_FETCH_CALL] = &&label_OPCODE_FETCH_CALL,
+        [OPCODE_FETCH_ADD] = &&label_OPCODE_FETCH_ADD,
+        [OPCODE_FETCH_SUB] = &&label_OPCODE_FETCH_SUB,
+        [OPCODE_FETCH_LT] = &&label_OPCODE_FETCH_LT,
+        [OPCODE_FETCH_LTE] = &&label_OPCODE_FETCH_LTE,
+        [OPCODE_ADD_NUM] = &&label_OPCODE_ADD_NUM,
+        [OPCODE_SUB_NUM] = &&label_OPCODE_SUB_NUM,
+        [OPCODE_MUL_NUM] = &&label_OPCODE_MUL_NUM,
+        [OPCODE_DIV_NUM] = &&label_OPCODE_DIV_NUM,
+        [OPCODE_GT_NUM] = &&label_OPCODE_GT_NUM,
+        [OPCODE_GTE_NUM] = &&label_OPCODE_GTE_NUM,
+        [OPCODE_LT_NUM] = &&label_OPCODE_LT_NUM,
+        [OPCODE_LTE_NUM] = &&label_OPCODE_LTE_NUM,
+        [OPCODE_FETCH_ADD_NUM] = &&label_OPCODE_FETCH_ADD_NUM,
+        [OPCODE_FETCH_SUB_NUM] = &&label_OPCODE_FETCH_SUB_NUM,
+        [OPCODE_FETCH_LT_NUM] = &&label_OPCODE_FETCH_LT_NUM,
+        [OPCODE_FETCH_LTE_NUM] = &&label_OPCODE_FETCH_LTE_NUM,
+        [OPCODE_COUNT] = &&label_OPCODE_COUNT,
+        [OPCODE_INVALID] = &&label_OPCODE_INVALID,
+    };
+
+    DecodedInstruction* instruction;
+    int operand;
+#endif
+
+    TRANSLATE();
+
     while (state->ip != endip && !state->errorflag && !stop)
     {
         //printf("-------------------------------------------------------------------\n");
@@ -718,158 +1166,205 @@ void state_execute(
         //nom_dumpcallstack(state);
         //printf("\n");
 
-        op = (OpCode)state->bytecode[state->ip++];
+        PROFILE_INSTRUCTION();
+
+        DECODE();
         switch (op)
         {
-        case OPCODE_PUSH:
-            result = READAS(NomValue);
+        OPERATION(OPCODE_PUSH):
+            result = OPERAND_CONSTANT();
             PUSH_VALUE(result);
-            break;
+            NEXT();
 
-        case OPCODE_POP:
+        OPERATION(OPCODE_POP):
             (void)POP_VALUE();
-            break;
+            NEXT();
 
-        case OPCODE_DUP:
-            count = READAS(uint32_t);
+        OPERATION(OPCODE_DUP):
+            count = OPERAND();
             result = PEEK_VALUE(count);
             PUSH_VALUE(result);
-            break;
+            NEXT();
 
-        case OPCODE_ADD:
+        OPERATION(OPCODE_ADD):
             l = POP_VALUE();
             r = POP_VALUE();
+            if (IS_NUMBER(l) && IS_NUMBER(r))
+            {
+                QUICKEN(OPCODE_ADD_NUM);
+            }
             result = nom_add(state, l, r);
             PUSH_VALUE(result);
-            break;
+            NEXT();
 
-        case OPCODE_SUB:
+        OPERATION(OPCODE_SUB):
             l = POP_VALUE();
             r = POP_VALUE();
+            if (IS_NUMBER(l) && IS_NUMBER(r))
+            {
+                QUICKEN(OPCODE_SUB_NUM);
+            }
             result = nom_sub(state, l, r);
             PUSH_VALUE(result);
-            break;
+            NEXT();
 
-        case OPCODE_MUL:
+        OPERATION(OPCODE_MUL):
             l = POP_VALUE();
             r = POP_VALUE();
+            if (IS_NUMBER(l) && IS_NUMBER(r))
+            {
+                QUICKEN(OPCODE_MUL_NUM);
+            }
             result = nom_mul(state, l, r);
             PUSH_VALUE(result);
-            break;
+            NEXT();
 
-        case OPCODE_DIV:
+        OPERATION(OPCODE_DIV):
             l = POP_VALUE();
             r = POP_VALUE();
+            if (IS_NUMBER(l) && IS_NUMBER(r))
+            {
+                QUICKEN(OPCODE_DIV_NUM);
+            }
             result = nom_div(state, l, r);
             PUSH_VALUE(result);
-            break;
+            NEXT();
 
-        case OPCODE_NEG:
+        OPERATION(OPCODE_NEG):
             l = POP_VALUE();
             result = nom_neg(state, l);
             PUSH_VALUE(result);
-            break;
+            NEXT();
 
-        case OPCODE_EQ:
+        OPERATION(OPCODE_EQ):
             l = POP_VALUE();
             r = POP_VALUE();
             result = nom_equals(state, l, r) ? nom_true() : nom_false();
             PUSH_VALUE(result);
-            break;
+            NEXT();
 
-        case OPCODE_NE:
+        OPERATION(OPCODE_NE):
             l = POP_VALUE();
             r = POP_VALUE();
             result = !nom_equals(state, l, r) ? nom_true() : nom_false();
             PUSH_VALUE(result);
-            break;
+            NEXT();
 
-        case OPCODE_GT:
+        OPERATION(OPCODE_GT):
             l = POP_VALUE();
             r = POP_VALUE();
+            if (IS_NUMBER(l) && IS_NUMBER(r))
+            {
+                QUICKEN(OPCODE_GT_NUM);
+            }
             result = nom_todouble(l) > nom_todouble(r) ? nom_true() : nom_false();
             PUSH_VALUE(result);
-            break;
+            NEXT();
 
-        case OPCODE_GTE:
+        OPERATION(OPCODE_GTE):
             l = POP_VALUE();
             r = POP_VALUE();
+            if (IS_NUMBER(l) && IS_NUMBER(r))
+            {
+                QUICKEN(OPCODE_GTE_NUM);
+            }
             result = nom_todouble(l) >= nom_todouble(r) ? nom_true() : nom_false();
             PUSH_VALUE(result);
-            break;
+            NEXT();
 
-        case OPCODE_LT:
+        OPERATION(OPCODE_LT):
             l = POP_VALUE();
             r = POP_VALUE();
+            if (IS_NUMBER(l) && IS_NUMBER(r))
+            {
+                QUICKEN(OPCODE_LT_NUM);
+            }
             result = nom_todouble(l) < nom_todouble(r) ? nom_true() : nom_false();
             PUSH_VALUE(result);
-            break;
+            NEXT();
 
-        case OPCODE_LTE:
+        OPERATION(OPCODE_LTE):
             l = POP_VALUE();
             r = POP_VALUE();
+            if (IS_NUMBER(l) && IS_NUMBER(r))
+            {
+                QUICKEN(OPCODE_LTE_NUM);
+            }
             result = nom_todouble(l) <= nom_todouble(r) ? nom_true() : nom_false();
             PUSH_VALUE(result);
-            break;
+            NEXT();
 
-        case OPCODE_AND:
+        OPERATION(OPCODE_AND):
             l = POP_VALUE();
             r = POP_VALUE();
             result = (nom_istrue(state, l) && nom_istrue(state, r)) ? nom_true() : nom_false();
             PUSH_VALUE(result);
-            break;
+            NEXT();
 
-        case OPCODE_OR:
+        OPERATION(OPCODE_OR):
             l = POP_VALUE();
             r = POP_VALUE();
             result = (nom_istrue(state, l) || nom_istrue(state, r)) ? nom_true() : nom_false();
             PUSH_VALUE(result);
-            break;
+            NEXT();
 
-        case OPCODE_NOT:
+        OPERATION(OPCODE_NOT):
             l = POP_VALUE();
             result = !nom_istrue(state, l) ? nom_true() : nom_false();
             PUSH_VALUE(result);
-            break;
+            NEXT();
 
-        case OPCODE_DEFINE:
-            id = READAS(StringId);
+        OPERATION(OPCODE_DEFINE):
+            id = OPERAND();
             state_letinterned(state, id, TOP_VALUE());
-            break;
+            NEXT();
 
-        case OPCODE_ASSIGN:
-            id = READAS(StringId);
+        OPERATION(OPCODE_ASSIGN):
+            id = OPERAND();
             state_setinterned(state, id, TOP_VALUE());
-            break;
+            NEXT();
 
-        case OPCODE_FETCH:
-            id = READAS(StringId);
+        OPERATION(OPCODE_DEFINE_DROP):
+            id = OPERAND();
+            state_letinterned(state, id, TOP_VALUE());
+            (void)POP_VALUE();
+            NEXT();
+
+        OPERATION(OPCODE_ASSIGN_DROP):
+            id = OPERAND();
+            state_setinterned(state, id, TOP_VALUE());
+            (void)POP_VALUE();
+            NEXT();
+
+        OPERATION(OPCODE_FETCH):
+            id = OPERAND();
             result = state_getinterned(state, id);
             PUSH_VALUE(result);
-            break;
+            NEXT();
 
-        case OPCODE_INSERT:
+        OPERATION(OPCODE_INSERT):
             l = POP_VALUE();
             r = POP_VALUE();
             if (!nom_insert(state, r, l, TOP_VALUE()))
             {
                 nom_seterror(state, "Value for key '%s' already exists", nom_getstring(state, l));
             }
-            break;
+            NEXT();
 
-        case OPCODE_UPDATE:
+        OPERATION(OPCODE_UPDATE):
             l = POP_VALUE();
             r = POP_VALUE();
             if (!nom_update(state, r, l, TOP_VALUE()))
             {
                 nom_seterror(state, "No value for key '%s'", nom_getstring(state, l));
             }
-            break;
+            NEXT();
 
-        case OPCODE_FIND:
+        OPERATION(OPCODE_FIND):
+            cache = OPERAND_CACHE();
             l = POP_VALUE();
             r = POP_VALUE();
-            if (!nom_find(state, r, l, &result))
+            if (!map_findcached(state, r, l, cache, &result))
             {
                 nom_seterror(state, "No value for key '%s'", nom_getstring(state, l));
             }
@@ -877,23 +1372,27 @@ void state_execute(
             {
                 PUSH_VALUE(result);
             }
-            break;
+            NEXT();
 
-        case OPCODE_GET:
+        OPERATION(OPCODE_GET):
+            cache = OPERAND_CACHE();
             l = POP_VALUE();
             r = POP_VALUE();
-            result = nom_get(state, r, l);
+            if (!map_findcached(state, r, l, cache, &result))
+            {
+                result = nom_nil();
+            }
             PUSH_VALUE(result);
-            break;
+            NEXT();
 
-        case OPCODE_SET:
+        OPERATION(OPCODE_SET):
             l = POP_VALUE();
             r = POP_VALUE();
             nom_set(state, r, l, TOP_VALUE());
-            break;
+            NEXT();
 
-        case OPCODE_MAP:
-            count = READAS(uint32_t);
+        OPERATION(OPCODE_MAP):
+            count = OPERAND();
             result = nom_newmap(state);
             for (uint32_t i = 0; i < count; ++i)
             {
@@ -902,84 +1401,592 @@ void state_execute(
                 map_set(state, result, key, value);
             }
             PUSH_VALUE(result);
-            break;
+            NEXT();
 
-        case OPCODE_FUNCTION:
-            ip = READAS(uint32_t);
-            count = READAS(uint32_t);
+        OPERATION(OPCODE_FUNCTION):
+            ip = OPERAND();
+            count = OPERAND();
             result = function_new(state, ip);
             for (uint32_t i = 0; i < count; ++i)
             {
-                StringId parameter = READAS(StringId);
+                StringId parameter = OPERAND_PARAMETER();
                 function_addparam(state, result, parameter);
             }
             PUSH_VALUE(result);
-            break;
+            NEXT();
 
-        case OPCODE_CLASSOF:
+        OPERATION(OPCODE_CLASSOF):
             result = state_classof(state, POP_VALUE());
             PUSH_VALUE(result);
-            break;
+            NEXT();
 
-        case OPCODE_JUMP:
-            ip = READAS(uint32_t);
+        OPERATION(OPCODE_JUMP):
+            ip = OPERAND();
             state->ip = ip;
-            break;
+            NEXT();
 
-        case OPCODE_JUMPIF:
-            ip = READAS(uint32_t);
+        OPERATION(OPCODE_JUMPIF):
+            ip = OPERAND();
             l = POP_VALUE();
             if (nom_istrue(state, l))
             {
                 state->ip = ip;
             }
-            break;
-
-        case OPCODE_CALL:
-            count = READAS(uint32_t);
-            call(state, count, false);
-            break;
+            NEXT();
 
-        case OPCODE_RET:
-            ret(state);
-            if (state->cp < startcp)
+        OPERATION(OPCODE_JUMPIF_KEEP):
+            ip = OPERAND();
+            if (nom_istrue(state, TOP_VALUE()))
             {
-                stop = true;
+                state->ip = ip;
             }
-            break;
+            NEXT();
 
-        case OPCODE_INVALID:
-            nom_seterror(state, "Invalid opcode");
-            break;
-        }
-    }
-}
+        OPERATION(OPCODE_JUMPIFNOT_KEEP):
+            ip = OPERAND();
+            if (!nom_istrue(state, TOP_VALUE()))
+            {
+                state->ip = ip;
+            }
+            NEXT();
 
-NomValue state_newclass(
-    NomState*   state,
-    const char* name
-)
-{
-    assert(state);
-    assert(name);
+        OPERATION(OPCODE_JUMPIF_EQ):
+        OPERATION(OPCODE_JUMPIFNOT_EQ):
+            ip = OPERAND();
+            l = POP_VALUE();
+            r = POP_VALUE();
+            condition = nom_equals(state, l, r);
+            PUSH_VALUE(condition ? nom_true() : nom_false());
+            if (condition == (op == OPCODE_JUMPIF_EQ))
+            {
+                state->ip = ip;
+            }
+            NEXT();
 
-    NomValue classname = nom_newinternedstring(state, name);
-    NomValue classvalue = nom_newmap(state);
-    nom_insert(state, classvalue, state->strings.name, classname);
-    map_setclass(state, classvalue, state->classes.class);
+        OPERATION(OPCODE_JUMPIF_NE):
+        OPERATION(OPCODE_JUMPIFNOT_NE):
+            ip = OPERAND();
+            l = POP_VALUE();
+            r = POP_VALUE();
+            condition = !nom_equals(state, l, r);
+            PUSH_VALUE(condition ? nom_true() : nom_false());
+            if (condition == (op == OPCODE_JUMPIF_NE))
+            {
+                state->ip = ip;
+            }
+            NEXT();
 
-    nom_letvar(state, name, classvalue);
+        OPERATION(OPCODE_JUMPIF_GT):
+        OPERATION(OPCODE_JUMPIFNOT_GT):
+            ip = OPERAND();
+            l = POP_VALUE();
+            r = POP_VALUE();
+            condition = COMPARE(l, >, r);
+            PUSH_VALUE(condition ? nom_true() : nom_false());
+            if (condition == (op == OPCODE_JUMPIF_GT))
+            {
+                state->ip = ip;
+            }
+            NEXT();
 
-    return classvalue;
-}
+        OPERATION(OPCODE_JUMPIF_GTE):
+        OPERATION(OPCODE_JUMPIFNOT_GTE):
+            ip = OPERAND();
+            l = POP_VALUE();
+            r = POP_VALUE();
+            condition = COMPARE(l, >=, r);
+            PUSH_VALUE(condition ? nom_true() : nom_false());
+            if (condition == (op == OPCODE_JUMPIF_GTE))
+            {
+                state->ip = ip;
+            }
+            NEXT();
 
-NomValue state_classof(
-    NomState*   state,
-    NomValue    value
-)
-{
-    assert(state);
-    assert(state);
+        OPERATION(OPCODE_JUMPIF_LT):
+        OPERATION(OPCODE_JUMPIFNOT_LT):
+            ip = OPERAND();
+            l = POP_VALUE();
+            r = POP_VALUE();
+            condition = COMPARE(l, <, r);
+            PUSH_VALUE(condition ? nom_true() : nom_false());
+            if (condition == (op == OPCODE_JUMPIF_LT))
+            {
+                state->ip = ip;
+            }
+            NEXT();
+
+        OPERATION(OPCODE_JUMPIF_LTE):
+        OPERATION(OPCODE_JUMPIFNOT_LTE):
+            ip = OPERAND();
+            l = POP_VALUE();
+            r = POP_VALUE();
+            condition = COMPARE(l, <=, r);
+            PUSH_VALUE(condition ? nom_true() : nom_false());
+            if (condition == (op == OPCODE_JUMPIF_LTE))
+            {
+                state->ip = ip;
+            }
+            NEXT();
+
+        OPERATION(OPCODE_CALL):
+            count = OPERAND();
+            call(state, count, false);
+            TRANSLATE();
+            NEXT();
+
+        OPERATION(OPCODE_CALL_METHOD):
+            id = OPERAND();
+            count = OPERAND();
+            l = state_classof(state, PEEK_VALUE(count - 1));
+            if (!state_findmethod(state, l, id, &result))
+            {
+                nom_seterror(state, "No value for key '%s'", stringpool_find(state->stringpool, id));
+            }
+            else
+            {
+                // Methods are almost always plain functions, so only resolve
+                // the method if it is not
+                if (!nom_isfunction(state, result))
+                {
+                    result = function_resolve(state, result);
+                }
+
+                if (nom_isfunction(state, result))
+                {
+                    invoke(state, result, count, false);
+                    TRANSLATE();
+                }
+                else
+                {
+                    nom_seterror(state, "Value cannot be called");
+                }
+            }
+            NEXT();
+
+        OPERATION(OPCODE_RET):
+            ret(state);
+            if (state->cp < startcp)
+            {
+                stop = true;
+            }
+            NEXT();
+
+        OPERATION(OPCODE_INLINE):
+            ip = OPERAND();
+            count = OPERAND();
+
+            // Continue with the inlined body if the function being called is
+            // the inlined function, otherwise jump to the call (the function
+            // is left on the stack for the call either way)
+            l = TOP_VALUE();
+            if (!nom_isfunction(state, l) || function_getip(state, l) != ip)
+            {
+                state->ip = count;
+            }
+            NEXT();
+
+        OPERATION(OPCODE_GUARD_NUM):
+            count = OPERAND();
+            ip = OPERAND();
+
+            // Leave the inlined body for the call if the arithmetic operation
+            // which follows could call an operator overload (which must see
+            // the stack frame of the call), dropping the values pushed by the
+            // body so far
+            if (!IS_NUMBER(PEEK_VALUE(0)) || !IS_NUMBER(PEEK_VALUE(1)))
+            {
+                state->sp -= count;
+                state->ip = ip;
+            }
+            NEXT();
+
+        OPERATION(OPCODE_SLIDE):
+            count = OPERAND();
+            result = POP_VALUE();
+            state->sp -= count;
+            PUSH_VALUE(result);
+            NEXT();
+
+        OPERATION(OPCODE_PUSH_FETCH):
+            result = OPERAND_CONSTANT();
+            PUSH_VALUE(result);
+            id = OPERAND();
+            result = state_getinterned(state, id);
+            PUSH_VALUE(result);
+            NEXT();
+
+        OPERATION(OPCODE_PUSH_FIND):
+            l = OPERAND_CONSTANT();
+            cache = OPERAND_CACHE();
+            r = POP_VALUE();
+            if (!map_findcached(state, r, l, cache, &result))
+            {
+                nom_seterror(state, "No value for key '%s'", nom_getstring(state, l));
+            }
+            else
+            {
+                PUSH_VALUE(result);
+            }
+            NEXT();
+
+        OPERATION(OPCODE_FETCH_FETCH):
+            id = OPERAND();
+            result = state_getinterned(state, id);
+            PUSH_VALUE(result);
+            id = OPERAND();
+            if (!state->errorflag)
+            {
+                result = state_getinterned(state, id);
+                PUSH_VALUE(result);
+            }
+            NEXT();
+
+        OPERATION(OPCODE_FETCH_CALL):
+            id = OPERAND();
+            count = OPERAND();
+            result = state_getinterned(state, id);
+            PUSH_VALUE(result);
+            if (!state->errorflag)
+            {
+                call(state, count, false);
+                TRANSLATE();
+            }
+            NEXT();
+
+        OPERATION(OPCODE_FETCH_ADD):
+            id = OPERAND();
+            l = state_getinterned(state, id);
+            if (!state->errorflag)
+            {
+                r = POP_VALUE();
+                if (IS_NUMBER(l) && IS_NUMBER(r))
+                {
+                    QUICKEN(OPCODE_FETCH_ADD_NUM);
+                }
+                result = nom_add(state, l, r);
+                PUSH_VALUE(result);
+            }
+            NEXT();
+
+        OPERATION(OPCODE_FETCH_SUB):
+            id = OPERAND();
+            l = state_getinterned(state, id);
+            if (!state->errorflag)
+            {
+                r = POP_VALUE();
+                if (IS_NUMBER(l) && IS_NUMBER(r))
+                {
+                    QUICKEN(OPCODE_FETCH_SUB_NUM);
+                }
+                result = nom_sub(state, l, r);
+                PUSH_VALUE(result);
+            }
+            NEXT();
+
+        OPERATION(OPCODE_FETCH_LT):
+            id = OPERAND();
+            l = state_getinterned(state, id);
+            if (!state->errorflag)
+            {
+                r = POP_VALUE();
+                if (IS_NUMBER(l) && IS_NUMBER(r))
+                {
+                    QUICKEN(OPCODE_FETCH_LT_NUM);
+                }
+                result = nom_todouble(l) < nom_todouble(r) ? nom_true() : nom_false();
+                PUSH_VALUE(result);
+            }
+            NEXT();
+
+        OPERATION(OPCODE_FETCH_LTE):
+            id = OPERAND();
+            l = state_getinterned(state, id);
+            if (!state->errorflag)
+            {
+                r = POP_VALUE();
+                if (IS_NUMBER(l) && IS_NUMBER(r))
+                {
+                    QUICKEN(OPCODE_FETCH_LTE_NUM);
+                }
+                result = nom_todouble(l) <= nom_todouble(r) ? nom_true() : nom_false();
+                PUSH_VALUE(result);
+            }
+            NEXT();
+
+        OPERATION(OPCODE_ADD_NUM):
+            l = POP_VALUE();
+            r = POP_VALUE();
+            if (IS_NUMBER(l) && IS_NUMBER(r))
+            {
+                result.number = l.number + r.number;
+            }
+            else
+            {
+                QUICKEN(OPCODE_ADD);
+                result = nom_add(state, l, r);
+            }
+            PUSH_VALUE(result);
+            NEXT();
+
+        OPERATION(OPCODE_SUB_NUM):
+            l = POP_VALUE();
+            r = POP_VALUE();
+            if (IS_NUMBER(l) && IS_NUMBER(r))
+            {
+                result.number = l.number - r.number;
+            }
+            else
+            {
+                QUICKEN(OPCODE_SUB);
+                result = nom_sub(state, l, r);
+            }
+            PUSH_VALUE(result);
+            NEXT();
+
+        OPERATION(OPCODE_MUL_NUM):
+            l = POP_VALUE();
+            r = POP_VALUE();
+            if (IS_NUMBER(l) && IS_NUMBER(r))
+            {
+                result.number = l.number * r.number;
+            }
+            else
+            {
+                QUICKEN(OPCODE_MUL);
+                result = nom_mul(state, l, r);
+            }
+            PUSH_VALUE(result);
+            NEXT();
+
+        OPERATION(OPCODE_DIV_NUM):
+            l = POP_VALUE();
+            r = POP_VALUE();
+            if (IS_NUMBER(l) && IS_NUMBER(r))
+            {
+                result.number = l.number / r.number;
+            }
+            else
+            {
+                QUICKEN(OPCODE_DIV);
+                result = nom_div(state, l, r);
+            }
+            PUSH_VALUE(result);
+            NEXT();
+
+        OPERATION(OPCODE_GT_NUM):
+            l = POP_VALUE();
+            r = POP_VALUE();
+            if (IS_NUMBER(l) && IS_NUMBER(r))
+            {
+                result = l.number > r.number ? nom_true() : nom_false();
+            }
+            else
+            {
+                QUICKEN(OPCODE_GT);
+                result = nom_todouble(l) > nom_todouble(r) ? nom_true() : nom_false();
+            }
+            PUSH_VALUE(result);
+            NEXT();
+
+        OPERATION(OPCODE_GTE_NUM):
+            l = POP_VALUE();
+            r = POP_VALUE();
+            if (IS_NUMBER(l) && IS_NUMBER(r))
+            {
+                result = l.number >= r.number ? nom_true() : nom_false();
+            }
+            else
+            {
+                QUICKEN(OPCODE_GTE);
+                result = nom_todouble(l) >= nom_todouble(r) ? nom_true() : nom_false();
+            }
+            PUSH_VALUE(result);
+            NEXT();
+
+        OPERATION(OPCODE_LT_NUM):
+            l = POP_VALUE();
+            r = POP_VALUE();
+            if (IS_NUMBER(l) && IS_NUMBER(r))
+            {
+                result = l.number < r.number ? nom_true() : nom_false();
+            }
+            else
+            {
+                QUICKEN(OPCODE_LT);
+                result = nom_todouble(l) < nom_todouble(r) ? nom_true() : nom_false();
+            }
+            PUSH_VALUE(result);
+            NEXT();
+
+        OPERATION(OPCODE_LTE_NUM):
+            l = POP_VALUE();
+            r = POP_VALUE();
+            if (IS_NUMBER(l) && IS_NUMBER(r))
+            {
+                result = l.number <= r.number ? nom_true() : nom_false();
+            }
+            else
+            {
+                QUICKEN(OPCODE_LTE);
+                result = nom_todouble(l) <= nom_todouble(r) ? nom_true() : nom_false();
+            }
+            PUSH_VALUE(result);
+            NEXT();
+
+        OPERATION(OPCODE_FETCH_ADD_NUM):
+            id = OPERAND();
+            l = state_getinterned(state, id);
+            if (!state->errorflag)
+            {
+                r = POP_VALUE();
+                if (IS_NUMBER(l) && IS_NUMBER(r))
+                {
+                    result.number = l.number + r.number;
+                }
+                else
+                {
+                    QUICKEN(OPCODE_FETCH_ADD);
+                    result = nom_add(state, l, r);
+                }
+                PUSH_VALUE(result);
+            }
+            NEXT();
+
+        OPERATION(OPCODE_FETCH_SUB_NUM):
+            id = OPERAND();
+            l = state_getinterned(state, id);
+            if (!state->errorflag)
+            {
+                r = POP_VALUE();
+                if (IS_NUMBER(l) && IS_NUMBER(r))
+                {
+                    result.number = l.number - r.number;
+                }
+                else
+                {
+                    QUICKEN(OPCODE_FETCH_SUB);
+                    result = nom_sub(state, l, r);
+                }
+                PUSH_VALUE(result);
+            }
+            NEXT();
+
+        OPERATION(OPCODE_FETCH_LT_NUM):
+            id = OPERAND();
+            l = state_getinterned(state, id);
+            if (!state->errorflag)
+            {
+                r = POP_VALUE();
+                if (IS_NUMBER(l) && IS_NUMBER(r))
+                {
+                    result = l.number < r.number ? nom_true() : nom_false();
+                }
+                else
+                {
+                    QUICKEN(OPCODE_FETCH_LT);
+                    result = nom_todouble(l) < nom_todouble(r) ? nom_true() : nom_false();
+                }
+                PUSH_VALUE(result);
+            }
+            NEXT();
+
+        OPERATION(OPCODE_FETCH_LTE_NUM):
+            id = OPERAND();
+            l = state_getinterned(state, id);
+            if (!state->errorflag)
+            {
+                r = POP_VALUE();
+                if (IS_NUMBER(l) && IS_NUMBER(r))
+                {
+                    result = l.number <= r.number ? nom_true() : nom_false();
+                }
+                else
+                {
+                    QUICKEN(OPCODE_FETCH_LTE);
+                    result = nom_todouble(l) <= nom_todouble(r) ? nom_true() : nom_false();
+                }
+                PUSH_VALUE(result);
+            }
+            NEXT();
+
+        OPERATION(OPCODE_COUNT):
+        OPERATION(OPCODE_INVALID):
+            nom_seterror(state, "Invalid opcode");
+            NEXT();
+        }
+    }
+}
+
+#ifdef THREADED_DISPATCH
+#pragma GCC diagnostic pop
+#endif
+
+bool state_findmethod(
+    NomState*   state,
+    NomValue    class,
+    StringId    selector,
+    NomValue*   method
+)
+{
+    assert(state);
+    assert(method);
+
+    // Only maps can be classes
+    MapData* data = map_getdata(state, class);
+    if (!data)
+    {
+        return false;
+    }
+
+    uint32_t classid = GET_ID(class);
+    uint32_t index = (classid * 31u + selector) % STATE_METHOD_CACHE_SIZE;
+    MethodCacheEntry* entry = &state->methodcache[index];
+
+    // Look up the method again if the cache entry is for a different
+    // class/selector or if entries have been removed from the class
+    if (entry->classid != classid || entry->selector != selector || entry->version != data->version)
+    {
+        uint32_t position;
+        if (!map_findentry(state, data, string_newinterned(selector), &position))
+        {
+            return false;
+        }
+
+        entry->classid = classid;
+        entry->selector = selector;
+        entry->version = data->version;
+        entry->entry = position;
+    }
+
+    *method = data->entries[entry->entry].value;
+    return true;
+}
+
+NomValue state_newclass(
+    NomState*   state,
+    const char* name
+)
+{
+    assert(state);
+    assert(name);
+
+    NomValue classname = nom_newinternedstring(state, name);
+    NomValue classvalue = nom_newmap(state);
+    nom_insert(state, classvalue, state->strings.name, classname);
+    map_setclass(state, classvalue, state->classes.class);
+
+    nom_letvar(state, name, classvalue);
+
+    return classvalue;
+}
+
+NomValue state_classof(
+    NomState*   state,
+    NomValue    value
+)
+{
+    assert(state);
+    assert(state);
 
     NomValue result = nom_nil();
 
@@ -997,6 +2004,7 @@ NomValue state_classof(
         result = state->classes.boolean;
         break;
     case VALUETYPE_INTERNED_STRING:
+    case VALUETYPE_SMALL_STRING:
         result = state->classes.string;
         break;
     case VALUETYPE_OBJECT:
@@ -1018,6 +2026,9 @@ NomValue state_classof(
                 case OBJECTTYPE_FUNCTION:
                     result = state->classes.function;
                     break;
+                case OBJECTTYPE_BYTES:
+                    result = state->classes.bytes;
+                    break;
                 }
             }
         }
@@ -1028,6 +2039,38 @@ NomValue state_classof(
     return result;
 }
 
+#ifdef NOM_OPCODE_PROFILE
+
+static void profileinstruction(
+    NomState*   state
+)
+{
+    assert(state);
+
+    // Only count pairs which are adjacent in the byte code (a pair across a
+    // jump, call or return could never be fused)
+    OpCode op = (OpCode)state->bytecode[state->ip];
+    if (state->lastopcode != OPCODE_INVALID && state->nextip == state->ip)
+    {
+        ++state->opcodepairs[state->lastopcode * OPCODE_COUNT + op];
+    }
+
+    state->lastopcode = op;
+    state->nextip = state->ip + instructionlength(state->bytecode, state->ip);
+}
+
+static int compareopcodepairs(
+    const void* a,
+    const void* b
+)
+{
+    uint64_t l = ((const OpCodePair*)a)->count;
+    uint64_t r = ((const OpCodePair*)b)->count;
+    return l < r ? 1 : (l > r ? -1 : 0);
+}
+
+#endif
+
 static void compile(
     NomState*   state,
     const char* source
@@ -1039,18 +2082,30 @@ static void compile(
     state->errorflag = false;
 
     Parser* p = parser_new(source, state->stringpool);
-    Node* node = parser_exprs(p, true);
 
-    if (!node)
+    // Compile directly to byte code if possible, otherwise compile through
+    // an AST (which also reports any parse error)
+    uint32_t start = state->end;
+    uint32_t end;
+    if (compiler_compile(p, state->bytecode, &state->constants, state->end, &end))
     {
-        nom_seterror(state, parser_geterror(p));
+        state->end = end;
     }
     else
     {
-        state->end = generatecode(node, state->bytecode, state->end);
-        node_free(node);
+        Node* node = parser_exprs(p, true);
+        if (!node)
+        {
+            nom_seterror(state, parser_geterror(p));
+        }
+        else
+        {
+            state->end = generatecode(node, state->bytecode, &state->constants, state->end);
+        }
     }
 
+    state->end = peephole_optimize(state->bytecode, start, state->end);
+
     parser_free(p);
 }
 
@@ -1084,65 +2139,218 @@ static void call(
     assert(state);
 
     NomValue value = POP_VALUE();
-    if (nom_iscallable(state, value))
+    value = function_resolve(state, value);
+    if (nom_isfunction(state, value))
+    {
+        invoke(state, value, argcount, execute);
+    }
+    else
     {
-        value = function_resolve(state, value);
+        nom_seterror(state, "Value cannot be called");
+    }
+}
 
-        PUSH_FRAME(state->ip, argcount);
+static void invoke(
+    NomState*   state,
+    NomValue    function,
+    uint8_t     argcount,
+    bool        execute
+)
+{
+    assert(state);
 
-        // Use the scope that the function was defined in as scope fallback for
-        // the duration of the function call (this would not be needed if we
-        // had actual closure support).
-        NomValue function_scope = function_getscope(state, value);
-        if (nom_ismap(state, function_scope))
-        {
-            TOP_FRAME()->functionscope = function_scope;
-        }
+    PUSH_FRAME(state->ip, argcount);
 
-        if (function_isnative(state, value))
-        {
-            NomFunction function = function_getnative(state, value);
-            value = function(state);
-            PUSH_VALUE(value);
-            ret(state);
-        }
-        else
+    // Use the scope that the function was defined in as scope fallback for
+    // the duration of the function call (this would not be needed if we
+    // had actual closure support).
+    NomValue function_scope = function_getscope(state, function);
+    if (nom_ismap(state, function_scope))
+    {
+        TOP_FRAME()->functionscope = function_scope;
+    }
+
+    if (function_isnative(state, function))
+    {
+        NomFunction native = function_getnative(state, function);
+        NomValue result = native(state);
+        PUSH_VALUE(result);
+        ret(state);
+    }
+    else
+    {
+        size_t paramcount = function_getparamcount(state, function);
+        if (argcount <= paramcount)
         {
-            size_t paramcount = function_getparamcount(state, value);
-            if (argcount <= paramcount)
+            size_t i = paramcount;
+            while (i > 0)
             {
-                size_t i = paramcount;
-                while (i > 0)
-                {
-                    --i;
-                    NomValue arg = nom_getarg(state, i);
-                    StringId param = function_getparam(state, value, i);
-                    state_letinterned(state, param, arg);
-                }
-                state->ip = function_getip(state, value);
-
-                if (execute)
-                {
-                    state_execute(state);
-                }
+                --i;
+                NomValue arg = nom_getarg(state, i);
+                StringId param = function_getparam(state, function, i);
+                state_letinterned(state, param, arg);
             }
-            else
+            state->ip = function_getip(state, function);
+
+            if (execute)
             {
-                nom_seterror(state, "Too many arguments given (expected %u)", paramcount);
+                state_execute(state);
             }
         }
+        else
+        {
+            nom_seterror(state, "Too many arguments given (expected %u)", paramcount);
+        }
+    }
+}
+
+static void mark(
+    NomState*   state,
+    NomValue    value
+)
+{
+    assert(state);
+
+    if (GET_TYPE(value) == VALUETYPE_INTERNED_STRING)
+    {
+        stringpool_mark(state->stringpool, GET_ID(value));
     }
     else
     {
-        nom_seterror(state, "Value cannot be called");
+        heap_mark(state->heap, value);
     }
 }
 
-static void mark(
+static InlineCache* readinlinecache(
     NomState*   state,
-    NomValue    value
+    uint32_t*   operand,
+    uint32_t*   decoded
+)
+{
+    assert(state);
+    assert(operand);
+
+    uint32_t index = *operand;
+
+    // Allocate a cache the first time the instruction is executed
+    if (index == INLINE_CACHE_NONE)
+    {
+        if (state->inlinecachecount >= state->inlinecachecapacity)
+        {
+            uint32_t capacity = state->inlinecachecapacity == 0 ? 64 : state->inlinecachecapacity * 2;
+            InlineCache* caches = (InlineCache*)realloc(state->inlinecaches, sizeof(InlineCache) * capacity);
+            assert(caches);
+
+            state->inlinecaches = caches;
+            state->inlinecachecapacity = capacity;
+        }
+
+        index = state->inlinecachecount++;
+        memset(&state->inlinecaches[index], 0, sizeof(InlineCache));
+
+        // Remember the cache in the instruction's operand (and in the
+        // decoded instruction if there is one)
+        *operand = index;
+        if (decoded)
+        {
+            *decoded = index;
+        }
+    }
+
+    return &state->inlinecaches[index];
+}
+
+#ifdef THREADED_DISPATCH
+
+static void translate(
+    NomState*           state,
+    void* const*        handlers,
+    uint32_t            ip
 )
 {
     assert(state);
-    heap_mark(state->heap, value);
+    assert(handlers);
+
+    // Allocate the decoded instructions the first time code is decoded
+    if (!state->decoded)
+    {
+        state->decoded = (DecodedInstruction*)calloc(STATE_MAX_BYTE_CODE, sizeof(DecodedInstruction));
+        assert(state->decoded);
+    }
+
+    const uint32_t* bytecode = state->bytecode;
+
+    // Decode each instruction up to the return which ends the function (or
+    // the end of the byte code), continuing past a return if a jump leads
+    // further
+    uint32_t furthest = ip;
+    while (ip < state->end)
+    {
+        OpCode op = (OpCode)bytecode[ip];
+        uint32_t length = instructionlength(bytecode, ip);
+
+        DecodedInstruction* instruction = &state->decoded[ip];
+        instruction->handler = handlers[op];
+        instruction->opcode = (uint32_t)op;
+        instruction->next = ip + length;
+        instruction->operands[0] = length > 1 ? bytecode[ip + 1] : 0;
+        instruction->operands[1] = length > 2 ? bytecode[ip + 2] : 0;
+
+        // Resolve the constant referenced by the instruction
+        if (op == OPCODE_PUSH || op == OPCODE_PUSH_FETCH || op == OPCODE_PUSH_FIND)
+        {
+            instruction->constant = state->constants.values[bytecode[ip + 1]];
+        }
+
+        uint32_t target = ip;
+        switch (op)
+        {
+        case OPCODE_JUMP:
+        case OPCODE_JUMPIF:
+        case OPCODE_JUMPIF_KEEP:
+        case OPCODE_JUMPIFNOT_KEEP:
+        case OPCODE_JUMPIF_EQ:
+        case OPCODE_JUMPIFNOT_EQ:
+        case OPCODE_JUMPIF_NE:
+        case OPCODE_JUMPIFNOT_NE:
+        case OPCODE_JUMPIF_GT:
+        case OPCODE_JUMPIFNOT_GT:
+        case OPCODE_JUMPIF_GTE:
+        case OPCODE_JUMPIFNOT_GTE:
+        case OPCODE_JUMPIF_LT:
+        case OPCODE_JUMPIFNOT_LT:
+        case OPCODE_JUMPIF_LTE:
+        case OPCODE_JUMPIFNOT_LTE:
+            target = bytecode[ip + 1];
+            break;
+        case OPCODE_INLINE:
+        case OPCODE_GUARD_NUM:
+            target = bytecode[ip + 2];
+            break;
+        default:
+            break;
+        }
+
+        // Skip the body of a function literal (which is decoded when the
+        // function is first called)
+        if (op == OPCODE_JUMP && bytecode[target] == OPCODE_FUNCTION && bytecode[target + 1] == ip + 2)
+        {
+            ip = target;
+            continue;
+        }
+
+        if (target > furthest)
+        {
+            furthest = target;
+        }
+
+        if (op == OPCODE_RET && ip >= furthest)
+        {
+            break;
+        }
+
+        ip = instruction->next;
+    }
 }
+
+#endif
@@ -25,6 +25,7 @@
 #define STATE_H
 
 #include "heap.h"
+#include "map.h"
 #include "stringpool.h"
 
 #include <nominal.h>
@@ -33,6 +34,27 @@
 #define STATE_MAX_CALLSTACK_SIZE    (128)
 #define STATE_MAX_BYTE_CODE         (8096)
 #define STATE_STRING_POOL_SIZE      (512)
+#define STATE_METHOD_CACHE_SIZE     (256)
+
+// The constants referenced by the byte code of a state
+typedef struct ConstantPool
+{
+    NomValue*   values;
+    uint32_t    count;
+    uint32_t    capacity;
+} ConstantPool;
+
+// An instruction decoded ahead of execution: the address of its handler, its
+// operands and the constant it references (only the first two operands are
+// decoded; see state_execute())
+typedef struct DecodedInstruction
+{
+    const void* handler;
+    NomValue    constant;
+    uint32_t    opcode;
+    uint32_t    next;
+    uint32_t    operands[2];
+} DecodedInstruction;
 
 // A stack frame
 typedef struct StackFrame
@@ -43,6 +65,15 @@ typedef struct StackFrame
     NomValue    functionscope;
 } StackFrame;
 
+// A remembered lookup of a method in a class
+typedef struct MethodCacheEntry
+{
+    uint32_t    classid;
+    uint32_t    version;
+    StringId    selector;
+    uint32_t    entry;
+} MethodCacheEntry;
+
 // A Nominal state
 struct NomState
 {
@@ -52,13 +83,31 @@ struct NomState
     StackFrame      callstack[STATE_MAX_CALLSTACK_SIZE];
     uint32_t        cp;
 
-    unsigned char   bytecode[STATE_MAX_BYTE_CODE];
+    // Byte code is a sequence of 32-bit words: each instruction is an opcode
+    // word followed by one word per operand
+    uint32_t        bytecode[STATE_MAX_BYTE_CODE];
     uint32_t        ip;
     uint32_t        end;
 
+    ConstantPool    constants;
+
+    // The instructions of each function decoded the first time the function
+    // is executed, indexed like the byte code (allocated when code is first
+    // decoded; only used with threaded dispatch)
+    DecodedInstruction* decoded;
+
     Heap*           heap;
     StringPool*     stringpool;
 
+    // Inline caches of FIND/GET instructions (allocated when the instruction
+    // is first executed)
+    InlineCache*    inlinecaches;
+    uint32_t        inlinecachecount;
+    uint32_t        inlinecachecapacity;
+
+    // Global cache of (class, selector) to method lookups
+    MethodCacheEntry    methodcache[STATE_METHOD_CACHE_SIZE];
+
     // References to intrinsic classes
     struct
     {
@@ -69,6 +118,7 @@ struct NomState
         NomValue    string;
         NomValue    map;
         NomValue    function;
+        NomValue    bytes;
         NomValue    module;
     } classes;
 
@@ -83,6 +133,14 @@ struct NomState
         NomValue    divide;
     } strings;
 
+#ifdef NOM_OPCODE_PROFILE
+    // Execution counts of each pair of adjacent instructions (indexed by the
+    // first opcode times the opcode count plus the second opcode)
+    uint64_t*       opcodepairs;
+    uint32_t        lastopcode;
+    uint32_t        nextip;
+#endif
+
     char            error[2048];
     bool            errorflag;
 };
@@ -119,7 +177,8 @@ NomValue state_getinterned(
     StringId    id
 );
 
-// Calls a function.
+// Calls a function directly (the value must already be resolved to a
+// function; see function_resolve()).
 //
 // The call may have encountered an error; check nom_error() directly
 // after calling this function
@@ -138,6 +197,15 @@ void state_execute(
     NomState*   state
 );
 
+// Finds the method for a selector in a class using the method cache,
+// returning true if the method was found or false otherwise
+bool state_findmethod(
+    NomState*   state,
+    NomValue    class,
+    StringId    selector,
+    NomValue*   method
+);
+
 // Creates a new map representing a class
 //
 // The call may have encountered an error; check nom_error() directly
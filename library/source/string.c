@@ -31,6 +31,58 @@
 #include <stdlib.h>
 #include <string.h>
 
+#define SMALL_STRING_LENGTH_SHIFT   (3)
+#define SMALL_STRING_LENGTH_MASK    (0x7)
+
+#define GET_SMALL_LENGTH(v) ((size_t)((v.data.lower >> SMALL_STRING_LENGTH_SHIFT) & SMALL_STRING_LENGTH_MASK))
+
+// Allocates a new string object on the heap of the given kind and length
+// with room for the bytes if the string is flat
+static StringData* newstringdata(
+    NomState*   state,
+    StringKind  kind,
+    size_t      length,
+    NomValue*   value
+);
+
+// Frees the data of a string object
+static void freestringdata(
+    void*   data
+);
+
+// Returns the data of a string object on the heap (NULL if the value is not
+// a string object)
+static StringData* getstringdata(
+    NomState*   state,
+    NomValue    value
+);
+
+// Returns the depth of the right side of a string (zero if the string is not
+// a rope)
+static uint32_t getropedepth(
+    NomState*   state,
+    NomValue    value
+);
+
+// Returns the hash of the bytes of a string
+static Hash hashbytes(
+    const char* string,
+    size_t      length
+);
+
+// Copies the bytes of a string to a buffer
+static void copystring(
+    NomState*   state,
+    NomValue    value,
+    char*       buffer
+);
+
+// Copies a rope, view, or external string into a buffer of its own
+static void flatten(
+    NomState*   state,
+    StringData* data
+);
+
 bool nom_isstring(
     NomState*   state,
     NomValue    value
@@ -41,7 +93,7 @@ bool nom_isstring(
     bool result = false;
 
     ValueType type = GET_TYPE(value);
-    if (type == VALUETYPE_INTERNED_STRING)
+    if (type == VALUETYPE_INTERNED_STRING || type == VALUETYPE_SMALL_STRING)
     {
         result = true;
     }
@@ -64,12 +116,7 @@ NomValue nom_newstring(
 {
     assert(state);
 
-    NomValue string = heap_alloc(state->heap, OBJECTTYPE_STRING, strlen(value) + 1, free);
-
-    // Copy the string to the object's data
-    char* data = heap_getdata(state->heap, string);
-    strcpy(data, value);
-
+    NomValue string = string_new(state, value, strlen(value));
     return string;
 }
 
@@ -90,6 +137,25 @@ NomValue nom_newinternedstring(
     return string;
 }
 
+NomValue nom_newexternalstring(
+    NomState*           state,
+    const char*         value,
+    size_t              length,
+    NomReleaseFunction  release
+)
+{
+    assert(state);
+    assert(value || length == 0);
+
+    // Reference the string without copying it
+    NomValue string;
+    StringData* data = newstringdata(state, STRINGKIND_EXTERNAL, length, &string);
+    data->string = (char*)value;
+    data->data.external.release = release;
+
+    return string;
+}
+
 const char* nom_getstring(
     NomState*   state,
     NomValue    value
@@ -98,18 +164,29 @@ const char* nom_getstring(
     assert(state);
 
     const char* string = NULL;
-    ValueType type = GET_TYPE(value);
-    if (type == VALUETYPE_INTERNED_STRING)
+    if (GET_TYPE(value) == VALUETYPE_SMALL_STRING)
     {
-        string = stringpool_find(state->stringpool, GET_ID(value));
+        // A small string has no NULL-terminated bytes to point to, so the
+        // pooled copy is returned (which is collected once unreferenced)
+        char buffer[SMALL_STRING_MAX_LENGTH];
+        memcpy(buffer, &value.data.upper, SMALL_STRING_MAX_LENGTH);
+
+        StringId id = stringpool_getidsubstring(state->stringpool, buffer, GET_SMALL_LENGTH(value));
+        string = stringpool_find(state->stringpool, id);
     }
-    else
+    else if (nom_isstring(state, value))
     {
-        HeapObject* object = heap_getobject(state->heap, value);
-        if (object && object->type == OBJECTTYPE_STRING)
+        // Views and external strings are copied since their bytes are not
+        // NULL-terminated
+        StringData* data = getstringdata(state, value);
+        if (data && (data->kind == STRINGKIND_VIEW || data->kind == STRINGKIND_EXTERNAL))
         {
-            string = heap_getdata(state->heap, value);
+            flatten(state, data);
         }
+
+        char buffer[SMALL_STRING_MAX_LENGTH];
+        size_t length;
+        string = string_getspan(state, value, buffer, &length);
     }
 
     return string;
@@ -124,3 +201,570 @@ NomValue string_newinterned(
     SET_ID(string, id);
     return string;
 }
+
+NomValue string_newsmall(
+    const char* string,
+    size_t      length
+)
+{
+    assert(string);
+    assert(length <= SMALL_STRING_MAX_LENGTH);
+
+    NomValue value = nom_nil();
+    SET_TYPE(value, VALUETYPE_SMALL_STRING);
+    value.data.lower |= (uint32_t)length << SMALL_STRING_LENGTH_SHIFT;
+
+    // The unused bytes remain zero so equal small strings have equal values
+    memcpy(&value.data.upper, string, length);
+
+    return value;
+}
+
+NomValue string_new(
+    NomState*   state,
+    const char* string,
+    size_t      length
+)
+{
+    assert(state);
+    assert(string);
+
+    if (length <= SMALL_STRING_MAX_LENGTH)
+    {
+        return string_newsmall(string, length);
+    }
+
+    NomValue value;
+    StringData* data = newstringdata(state, STRINGKIND_FLAT, length, &value);
+
+    // Copy the string to the object's data
+    memcpy(data->string, string, length);
+    data->string[length] = '\0';
+
+    return value;
+}
+
+NomValue string_concat(
+    NomState*   state,
+    NomValue    left,
+    NomValue    right
+)
+{
+    assert(state);
+
+    size_t leftlength = string_getlength(state, left);
+    size_t rightlength = string_getlength(state, right);
+
+    // Concatenating an empty string has no effect
+    if (leftlength == 0)
+    {
+        return right;
+    }
+    else if (rightlength == 0)
+    {
+        return left;
+    }
+
+    NomValue value;
+    size_t length = leftlength + rightlength;
+    if (length <= SMALL_STRING_MAX_LENGTH)
+    {
+        char buffer[SMALL_STRING_MAX_LENGTH];
+        copystring(state, left, buffer);
+        copystring(state, right, buffer + leftlength);
+        value = string_newsmall(buffer, length);
+    }
+    else if (length <= STRING_MIN_ROPE_LENGTH)
+    {
+        // Short strings are simply copied
+        StringData* data = newstringdata(state, STRINGKIND_FLAT, length, &value);
+        copystring(state, left, data->string);
+        copystring(state, right, data->string + leftlength);
+        data->string[length] = '\0';
+    }
+    else
+    {
+        // Keep the right side of the rope shallow so that copying or visiting
+        // it never recurses too deeply
+        uint32_t rightdepth = getropedepth(state, right) + 1;
+        if (rightdepth > STRING_MAX_ROPE_DEPTH)
+        {
+            flatten(state, getstringdata(state, right));
+            rightdepth = 1;
+        }
+
+        uint32_t leftdepth = getropedepth(state, left);
+
+        StringData* data = newstringdata(state, STRINGKIND_ROPE, length, &value);
+        data->data.rope.left = left;
+        data->data.rope.right = right;
+        data->data.rope.depth = leftdepth > rightdepth ? leftdepth : rightdepth;
+    }
+
+    return value;
+}
+
+const char* string_getspan(
+    NomState*   state,
+    NomValue    value,
+    char*       buffer,
+    size_t*     length
+)
+{
+    assert(state);
+    assert(buffer);
+    assert(length);
+
+    const char* string = NULL;
+    if (GET_TYPE(value) == VALUETYPE_SMALL_STRING)
+    {
+        memcpy(buffer, &value.data.upper, SMALL_STRING_MAX_LENGTH);
+        string = buffer;
+        *length = GET_SMALL_LENGTH(value);
+    }
+    else if (GET_TYPE(value) == VALUETYPE_INTERNED_STRING)
+    {
+        StringId id = GET_ID(value);
+        string = stringpool_find(state->stringpool, id);
+        *length = stringpool_length(state->stringpool, id);
+    }
+    else
+    {
+        StringData* data = getstringdata(state, value);
+        assert(data);
+
+        if (data->kind == STRINGKIND_VIEW)
+        {
+            // The parent of a view is never a view or a rope
+            char parentbuffer[SMALL_STRING_MAX_LENGTH];
+            size_t parentlength;
+            string = string_getspan(state, data->data.view.parent, parentbuffer, &parentlength);
+            string += data->data.view.offset;
+        }
+        else
+        {
+            // Ropes are flattened the first time they are read
+            if (data->kind == STRINGKIND_ROPE)
+            {
+                flatten(state, data);
+            }
+
+            string = data->string;
+        }
+
+        *length = data->length;
+    }
+
+    return string;
+}
+
+NomValue string_slice(
+    NomState*   state,
+    NomValue    value,
+    size_t      start,
+    size_t      length
+)
+{
+    assert(state);
+    assert(start + length <= string_getlength(state, value));
+
+    // Short ranges are simply copied
+    if (length <= SMALL_STRING_MAX_LENGTH)
+    {
+        char buffer[SMALL_STRING_MAX_LENGTH];
+        size_t parentlength;
+        const char* string = string_getspan(state, value, buffer, &parentlength);
+        return string_newsmall(string + start, length);
+    }
+    else if (start == 0 && length == string_getlength(state, value))
+    {
+        return value;
+    }
+
+    // Reference the string which holds the bytes directly
+    NomValue parent = value;
+    StringData* parentdata = getstringdata(state, value);
+    if (parentdata)
+    {
+        if (parentdata->kind == STRINGKIND_VIEW)
+        {
+            parent = parentdata->data.view.parent;
+            start += parentdata->data.view.offset;
+        }
+        else if (parentdata->kind == STRINGKIND_ROPE)
+        {
+            flatten(state, parentdata);
+        }
+    }
+
+    NomValue view;
+    StringData* data = newstringdata(state, STRINGKIND_VIEW, length, &view);
+    data->data.view.parent = parent;
+    data->data.view.offset = start;
+    return view;
+}
+
+bool string_find(
+    NomState*   state,
+    NomValue    value,
+    NomValue    substring,
+    size_t      start,
+    size_t*     index
+)
+{
+    assert(state);
+    assert(index);
+
+    char buffer[SMALL_STRING_MAX_LENGTH];
+    size_t length;
+    const char* string = string_getspan(state, value, buffer, &length);
+
+    char subbuffer[SMALL_STRING_MAX_LENGTH];
+    size_t sublength;
+    const char* substringbytes = string_getspan(state, substring, subbuffer, &sublength);
+
+    if (start > length || sublength > length - start)
+    {
+        return false;
+    }
+    else if (sublength == 0)
+    {
+        *index = start;
+        return true;
+    }
+
+    // Find each occurrence of the first byte and compare the rest
+    const char* end = string + length - sublength + 1;
+    const char* current = string + start;
+    while (current < end)
+    {
+        current = (const char*)memchr(current, substringbytes[0], (size_t)(end - current));
+        if (!current)
+        {
+            break;
+        }
+
+        if (memcmp(current, substringbytes, sublength) == 0)
+        {
+            *index = (size_t)(current - string);
+            return true;
+        }
+
+        ++current;
+    }
+
+    return false;
+}
+
+void string_visit(
+    NomState*       state,
+    NomValue        value,
+    ValueVisitor    visitor
+)
+{
+    assert(state);
+    assert(visitor);
+
+    StringData* data = getstringdata(state, value);
+    if (data && data->kind == STRINGKIND_VIEW)
+    {
+        visitor(state, data->data.view.parent);
+        return;
+    }
+
+    // Follow the left side of ropes iteratively since it may be deep
+    while (data && data->kind == STRINGKIND_ROPE)
+    {
+        NomValue left = data->data.rope.left;
+        NomValue right = data->data.rope.right;
+
+        visitor(state, right);
+        string_visit(state, right, visitor);
+
+        visitor(state, left);
+        data = getstringdata(state, left);
+    }
+}
+
+size_t string_getlength(
+    NomState*   state,
+    NomValue    value
+)
+{
+    assert(state);
+
+    size_t length = 0;
+    if (GET_TYPE(value) == VALUETYPE_SMALL_STRING)
+    {
+        length = GET_SMALL_LENGTH(value);
+    }
+    else if (GET_TYPE(value) == VALUETYPE_INTERNED_STRING)
+    {
+        length = stringpool_length(state->stringpool, GET_ID(value));
+    }
+    else
+    {
+        StringData* data = getstringdata(state, value);
+        assert(data);
+        length = data->length;
+    }
+
+    return length;
+}
+
+Hash string_gethash(
+    NomState*   state,
+    NomValue    value
+)
+{
+    assert(state);
+
+    Hash hash = 0;
+    if (GET_TYPE(value) == VALUETYPE_SMALL_STRING)
+    {
+        char buffer[SMALL_STRING_MAX_LENGTH];
+        size_t length;
+        const char* string = string_getspan(state, value, buffer, &length);
+        hash = hashbytes(string, length);
+    }
+    else if (GET_TYPE(value) == VALUETYPE_INTERNED_STRING)
+    {
+        hash = stringpool_hash(state->stringpool, GET_ID(value));
+    }
+    else
+    {
+        StringData* data = getstringdata(state, value);
+        assert(data);
+
+        // Compute the hash the first time it is needed
+        if (!data->hashed)
+        {
+            char buffer[SMALL_STRING_MAX_LENGTH];
+            size_t length;
+            const char* string = string_getspan(state, value, buffer, &length);
+
+            data->hash = hashbytes(string, length);
+            data->hashed = true;
+        }
+
+        hash = data->hash;
+    }
+
+    return hash;
+}
+
+bool string_equals(
+    NomState*   state,
+    NomValue    left,
+    NomValue    right
+)
+{
+    assert(state);
+
+    // Interned strings are equal only if they are the same string and small
+    // strings are equal only if they are the same value
+    ValueType lefttype = GET_TYPE(left);
+    ValueType righttype = GET_TYPE(right);
+    if (lefttype == righttype &&
+            (lefttype == VALUETYPE_INTERNED_STRING || lefttype == VALUETYPE_SMALL_STRING))
+    {
+        return left.raw == right.raw;
+    }
+
+    // Strings of different lengths or hashes can not be equal
+    size_t length = string_getlength(state, left);
+    if (length != string_getlength(state, right) ||
+            string_gethash(state, left) != string_gethash(state, right))
+    {
+        return false;
+    }
+
+    char leftbuffer[SMALL_STRING_MAX_LENGTH];
+    char rightbuffer[SMALL_STRING_MAX_LENGTH];
+    size_t leftlength;
+    size_t rightlength;
+    const char* leftstring = string_getspan(state, left, leftbuffer, &leftlength);
+    const char* rightstring = string_getspan(state, right, rightbuffer, &rightlength);
+    return memcmp(leftstring, rightstring, length) == 0;
+}
+
+static StringData* newstringdata(
+    NomState*   state,
+    StringKind  kind,
+    size_t      length,
+    NomValue*   value
+)
+{
+    assert(state);
+    assert(value);
+
+    // Only flat strings have room for their bytes
+    size_t size = sizeof(StringData);
+    if (kind == STRINGKIND_FLAT)
+    {
+        size += length + 1;
+    }
+
+    *value = heap_alloc(state->heap, OBJECTTYPE_STRING, size, freestringdata);
+
+    StringData* data = (StringData*)heap_getdata(state->heap, *value);
+    data->kind = kind;
+    data->length = length;
+    data->hash = 0;
+    data->hashed = false;
+    data->string = kind == STRINGKIND_FLAT ? data->buffer : NULL;
+    return data;
+}
+
+static void freestringdata(
+    void*   data
+)
+{
+    StringData* stringdata = (StringData*)data;
+
+    if (stringdata->kind == STRINGKIND_EXTERNAL)
+    {
+        // Release the host's string
+        if (stringdata->data.external.release)
+        {
+            stringdata->data.external.release(stringdata->string);
+        }
+    }
+    else if (stringdata->string && stringdata->string != stringdata->buffer)
+    {
+        // Free the buffer of a flattened rope or view
+        free(stringdata->string);
+    }
+
+    free(stringdata);
+}
+
+static StringData* getstringdata(
+    NomState*   state,
+    NomValue    value
+)
+{
+    assert(state);
+
+    StringData* data = NULL;
+
+    HeapObject* object = heap_getobject(state->heap, value);
+    if (object && object->type == OBJECTTYPE_STRING)
+    {
+        data = (StringData*)object->data;
+    }
+
+    return data;
+}
+
+static uint32_t getropedepth(
+    NomState*   state,
+    NomValue    value
+)
+{
+    assert(state);
+
+    uint32_t depth = 0;
+
+    StringData* data = getstringdata(state, value);
+    if (data && data->kind == STRINGKIND_ROPE)
+    {
+        depth = data->data.rope.depth;
+    }
+
+    return depth;
+}
+
+static Hash hashbytes(
+    const char* string,
+    size_t      length
+)
+{
+    Hash hash = HASH_STRING_INITIAL;
+    for (size_t i = 0; i < length; ++i)
+    {
+        hash = HASH_STRING_STEP(hash, string[i]);
+    }
+    return hash;
+}
+
+static void copystring(
+    NomState*   state,
+    NomValue    value,
+    char*       buffer
+)
+{
+    assert(state);
+    assert(buffer);
+
+    for (;;)
+    {
+        StringData* data = getstringdata(state, value);
+        if (!data || data->kind != STRINGKIND_ROPE)
+        {
+            char smallbuffer[SMALL_STRING_MAX_LENGTH];
+            size_t length;
+            const char* string = string_getspan(state, value, smallbuffer, &length);
+            memcpy(buffer, string, length);
+            return;
+        }
+
+        // Copy the right side of the rope and continue down the left side
+        size_t leftlength = string_getlength(state, data->data.rope.left);
+        copystring(state, data->data.rope.right, buffer + leftlength);
+        value = data->data.rope.left;
+    }
+}
+
+static void flatten(
+    NomState*   state,
+    StringData* data
+)
+{
+    assert(state);
+    assert(data);
+
+    char* string = NULL;
+    if (data->kind == STRINGKIND_ROPE)
+    {
+        string = (char*)malloc(data->length + 1);
+        assert(string);
+
+        size_t leftlength = string_getlength(state, data->data.rope.left);
+        copystring(state, data->data.rope.left, string);
+        copystring(state, data->data.rope.right, string + leftlength);
+    }
+    else if (data->kind == STRINGKIND_VIEW)
+    {
+        string = (char*)malloc(data->length + 1);
+        assert(string);
+
+        char buffer[SMALL_STRING_MAX_LENGTH];
+        size_t length;
+        const char* parent = string_getspan(state, data->data.view.parent, buffer, &length);
+        memcpy(string, parent + data->data.view.offset, data->length);
+    }
+    else if (data->kind == STRINGKIND_EXTERNAL)
+    {
+        string = (char*)malloc(data->length + 1);
+        assert(string);
+
+        memcpy(string, data->string, data->length);
+
+        // The host's string is no longer needed
+        if (data->data.external.release)
+        {
+            data->data.external.release(data->string);
+        }
+    }
+    else
+    {
+        return;
+    }
+
+    string[data->length] = '\0';
+
+    // The flattened string no longer references the strings it was made of
+    data->kind = STRINGKIND_FLAT;
+    data->string = string;
+}
@@ -25,12 +25,153 @@
 #define STRING_H
 
 #include "stringpool.h"
+#include "value.h"
 
 #include <nominal.h>
 
+// Strings up to this length are packed directly in a value instead of being
+// allocated on the heap (the bytes are stored in the upper word of the value
+// and the length in the unused bits of the lower word)
+#define SMALL_STRING_MAX_LENGTH (4)
+
+// Strings with a combined length up to this are concatenated by copying
+// instead of creating a rope
+#define STRING_MIN_ROPE_LENGTH  (64)
+
+// The maximum depth of the right side of a rope (the left side of a rope may
+// be arbitrarily deep so that repeated appending stays linear)
+#define STRING_MAX_ROPE_DEPTH   (32)
+
+// The kind of a string object on the heap
+typedef enum
+{
+    STRINGKIND_FLAT,
+    STRINGKIND_ROPE,
+    STRINGKIND_VIEW,
+    STRINGKIND_EXTERNAL
+} StringKind;
+
+// The data of a string object on the heap
+//
+// The length is stored ahead of the string and the hash is computed the first
+// time it is needed.  A flat string holds its NULL-terminated bytes in the
+// buffer following the header.  A rope is the concatenation of two other
+// strings and has no bytes until it is first read, at which point it is
+// flattened into a separate buffer and releases the two strings.  A view
+// references a range of the bytes of another string without copying them
+// and is only copied if a NULL-terminated string is needed.  An external
+// string references bytes owned by the host which are released once the
+// string is collected or copied
+typedef struct StringData
+{
+    StringKind  kind;
+    size_t      length;
+    Hash        hash;
+    bool        hashed;
+    char*       string;
+    union
+    {
+        struct
+        {
+            NomValue    left;
+            NomValue    right;
+            uint32_t    depth;
+        } rope;
+        struct
+        {
+            NomValue    parent;
+            size_t      offset;
+        } view;
+        struct
+        {
+            NomReleaseFunction  release;
+        } external;
+    } data;
+    char        buffer[];
+} StringData;
+
 // Creates an interned string from a string ID
 NomValue string_newinterned(
     StringId    id
 );
 
+// Creates a small string from a string of the given length (the length must
+// be at most SMALL_STRING_MAX_LENGTH)
+NomValue string_newsmall(
+    const char* string,
+    size_t      length
+);
+
+// Creates a new string from a string of the given length (either a small
+// string or a string object on the heap)
+NomValue string_new(
+    NomState*   state,
+    const char* string,
+    size_t      length
+);
+
+// Creates a string which is the concatenation of two string values
+NomValue string_concat(
+    NomState*   state,
+    NomValue    left,
+    NomValue    right
+);
+
+// Creates a string referencing a range of the bytes of a string value
+// without copying them (the range must be within the string)
+NomValue string_slice(
+    NomState*   state,
+    NomValue    value,
+    size_t      start,
+    size_t      length
+);
+
+// Finds the first occurrence of a substring in a string value at or after the
+// given index, returning true and outputting the index if it was found or
+// false otherwise
+bool string_find(
+    NomState*   state,
+    NomValue    value,
+    NomValue    substring,
+    size_t      start,
+    size_t*     index
+);
+
+// Returns a pointer to the bytes of a string value (flattening the string if
+// it is a rope) and outputs its length; the bytes of a small string are
+// unpacked into the buffer, which must hold SMALL_STRING_MAX_LENGTH bytes
+const char* string_getspan(
+    NomState*   state,
+    NomValue    value,
+    char*       buffer,
+    size_t*     length
+);
+
+// Visits the strings referenced by a string value
+void string_visit(
+    NomState*       state,
+    NomValue        value,
+    ValueVisitor    visitor
+);
+
+// Returns the length of a string value
+size_t string_getlength(
+    NomState*   state,
+    NomValue    value
+);
+
+// Returns the hash of a string value (the same as hashstring() for the value
+// returned by nom_getstring())
+Hash string_gethash(
+    NomState*   state,
+    NomValue    value
+);
+
+// Returns whether two string values are equal
+bool string_equals(
+    NomState*   state,
+    NomValue    left,
+    NomValue    right
+);
+
 #endif
@@ -27,24 +27,82 @@
 #include <stdlib.h>
 #include <string.h>
 
+#define STRINGPOOL_ARENA_CHUNK_SIZE (16384)
+
+// Returns the hash of a substring (the same as hashstring() for the
+// NULL-terminated string)
+static Hash hashsubstring(
+    const char* string,
+    size_t      length
+);
+
+// Returns the slot in the index of a pool for the specified substring (the
+// slot either contains the ID of the matching string or is empty)
+static StringId* findslot(
+    StringPool* stringpool,
+    const char* string,
+    size_t      length,
+    Hash        hash
+);
+
+// Grows the arrays and the index of a pool to fit another string
+static void reservestring(
+    StringPool* stringpool
+);
+
+// Rebuilds the index of a pool at the given capacity from the strings in the
+// pool
+static void rebuildindex(
+    StringPool* stringpool,
+    size_t      indexcapacity
+);
+
+// Copies the remaining strings of a pool into a new arena and frees the old
+// arena
+static void compactarena(
+    StringPool* stringpool
+);
+
 StringPool* stringpool_new(
     size_t  stringcount
 )
 {
+    assert(stringcount > 0);
+
     StringPool* stringpool = (StringPool*)malloc(sizeof(StringPool));
     assert(stringpool);
-    stringpool->hashtable = hashtable_new(hashstring, comparestring, 0, stringcount * 2);
+    memset(stringpool, 0, sizeof(StringPool));
+
+    stringpool->arena = arena_new(STRINGPOOL_ARENA_CHUNK_SIZE);
 
-    stringpool->strings = (char**)malloc(sizeof(char*)* stringcount);
+    stringpool->strings = (const char**)malloc(sizeof(const char*) * stringcount);
     assert(stringpool->strings);
-    memset(stringpool->strings, 0, sizeof(char*) * stringcount);
 
     stringpool->hashes = (Hash*)malloc(sizeof(Hash) * stringcount);
     assert(stringpool->hashes);
-    memset(stringpool->hashes, 0, sizeof(Hash)* stringcount);
 
-    stringpool->stringcount = stringcount;
-    stringpool->nextid = 0;
+    stringpool->lengths = (size_t*)malloc(sizeof(size_t) * stringcount);
+    assert(stringpool->lengths);
+
+    stringpool->flags = (uint8_t*)malloc(sizeof(uint8_t) * stringcount);
+    assert(stringpool->flags);
+
+    stringpool->refcounts = (int32_t*)malloc(sizeof(int32_t) * stringcount);
+    assert(stringpool->refcounts);
+
+    stringpool->freeids = (StringId*)malloc(sizeof(StringId) * stringcount);
+    assert(stringpool->freeids);
+
+    stringpool->capacity = stringcount;
+
+    // Keep the index a power of two at most half full
+    size_t indexcapacity = 1;
+    while (indexcapacity < stringcount * 2)
+    {
+        indexcapacity *= 2;
+    }
+    rebuildindex(stringpool, indexcapacity);
+
     return stringpool;
 }
 
@@ -54,36 +112,16 @@ void stringpool_free(
 {
     assert(stringpool);
 
-    // Free the string hashes
-    if (stringpool->hashes)
-    {
-        free(stringpool->hashes);
-    }
-
-    // Free the individual strings
-    if (stringpool->strings)
-    {
-        StringId i;
-        for (i = 0; i < stringpool->stringcount; ++i)
-        {
-            if (stringpool->strings[i])
-            {
-                free(stringpool->strings[i]);
-            }
-        }
-    }
-
-    // Free the strings array
-    if (stringpool->strings)
-    {
-        free(stringpool->strings);
-    }
+    free(stringpool->index);
+    free(stringpool->freeids);
+    free(stringpool->refcounts);
+    free(stringpool->flags);
+    free(stringpool->lengths);
+    free(stringpool->hashes);
+    free((void*)stringpool->strings);
 
-    // Free the hash table of strings
-    if (stringpool->hashtable)
-    {
-        hashtable_free(stringpool->hashtable, NULL, NULL);
-    }
+    // Free the bytes of all strings at once
+    arena_free(stringpool->arena);
 
     free(stringpool);
 }
@@ -101,26 +139,58 @@ StringId stringpool_getidsubstring(
     const char* string,
     size_t      length)
 {
-    char* newstring = (char*)malloc(sizeof(char) * (length + 1));
-    assert(newstring);
+    return stringpool_getidhashed(stringpool, string, length, hashsubstring(string, length));
+}
 
+StringId stringpool_getidhashed(
+    StringPool* stringpool,
+    const char* string,
+    size_t      length,
+    Hash        hash
+)
+{
+    assert(stringpool);
+    assert(string);
+
+    // The string is only copied if it is not already in the pool
+    StringId* slot = findslot(stringpool, string, length, hash);
+    if (*slot != STRINGPOOL_NO_ID)
+    {
+        return *slot;
+    }
+
+    // Growing may rebuild the index so the slot is found again afterwards
+    if (stringpool->freecount == 0 && stringpool->nextid >= stringpool->capacity)
+    {
+        reservestring(stringpool);
+        slot = findslot(stringpool, string, length, hash);
+    }
+
+    char* newstring = (char*)arena_alloc(stringpool->arena, length + 1);
     memcpy(newstring, string, length);
     newstring[length] = '\0';
 
+    stringpool->stringbytes += length + 1;
+    stringpool->arenabytes += length + 1;
+
+    // Reuse the ID of a collected string if there is one
     StringId id;
-    UserData outputId = 0;
-    if (!hashtable_insertorget(stringpool->hashtable, (UserData)newstring, (UserData)stringpool->nextid, &outputId))
+    if (stringpool->freecount > 0)
     {
-        id = stringpool->nextid;
-        stringpool->strings[id] = newstring;
-        stringpool->hashes[id] = hashstring((UserData)newstring, 0);
-        ++stringpool->nextid;
+        id = stringpool->freeids[--stringpool->freecount];
     }
     else
     {
-        id = (StringId)outputId;
-        free(newstring);
+        id = stringpool->nextid++;
     }
+
+    stringpool->strings[id] = newstring;
+    stringpool->hashes[id] = hash;
+    stringpool->lengths[id] = length;
+    stringpool->flags[id] = 0;
+    stringpool->refcounts[id] = 0;
+    *slot = id;
+
     return id;
 }
 
@@ -129,7 +199,12 @@ const char* stringpool_find(
     StringId    id
 )
 {
-    return stringpool->strings[id];
+    const char* string = NULL;
+    if (id < stringpool->nextid)
+    {
+        string = stringpool->strings[id];
+    }
+    return string;
 }
 
 Hash stringpool_hash(
@@ -137,5 +212,242 @@ Hash stringpool_hash(
     StringId    id
 )
 {
+    assert(stringpool_find(stringpool, id));
     return stringpool->hashes[id];
 }
+
+size_t stringpool_length(
+    StringPool* stringpool,
+    StringId    id
+)
+{
+    assert(stringpool_find(stringpool, id));
+    return stringpool->lengths[id];
+}
+
+void stringpool_pin(
+    StringPool* stringpool,
+    StringId    id
+)
+{
+    assert(stringpool_find(stringpool, id));
+    stringpool->flags[id] |= STRINGPOOL_PINNED;
+}
+
+void stringpool_acquire(
+    StringPool* stringpool,
+    StringId    id
+)
+{
+    assert(stringpool_find(stringpool, id));
+    ++stringpool->refcounts[id];
+}
+
+void stringpool_release(
+    StringPool* stringpool,
+    StringId    id
+)
+{
+    assert(stringpool_find(stringpool, id));
+    --stringpool->refcounts[id];
+}
+
+void stringpool_mark(
+    StringPool* stringpool,
+    StringId    id
+)
+{
+    if (stringpool_find(stringpool, id))
+    {
+        stringpool->flags[id] |= STRINGPOOL_MARKED;
+    }
+}
+
+size_t stringpool_sweep(
+    StringPool* stringpool
+)
+{
+    assert(stringpool);
+
+    size_t count = 0;
+
+    for (StringId id = 0; id < stringpool->nextid; ++id)
+    {
+        // If the string is allocated
+        if (stringpool->strings[id])
+        {
+            // Either unmark the string or free it
+            if (stringpool->flags[id] & STRINGPOOL_MARKED)
+            {
+                stringpool->flags[id] &= ~STRINGPOOL_MARKED;
+            }
+            else if (!(stringpool->flags[id] & STRINGPOOL_PINNED) && stringpool->refcounts[id] <= 0)
+            {
+                stringpool->stringbytes -= stringpool->lengths[id] + 1;
+                stringpool->strings[id] = NULL;
+                stringpool->freeids[stringpool->freecount++] = id;
+                ++count;
+            }
+        }
+    }
+
+    if (count > 0)
+    {
+        // Reclaim the bytes of the collected strings once most of the arena
+        // is unused
+        if (stringpool->arenabytes > STRINGPOOL_ARENA_CHUNK_SIZE &&
+            stringpool->stringbytes * 2 < stringpool->arenabytes)
+        {
+            compactarena(stringpool);
+        }
+
+        // Rebuild the index without the collected strings
+        rebuildindex(stringpool, stringpool->indexcapacity);
+    }
+
+    return count;
+}
+
+static Hash hashsubstring(
+    const char* string,
+    size_t      length
+)
+{
+    Hash hash = HASH_STRING_INITIAL;
+
+    for (size_t i = 0; i < length; ++i)
+    {
+        hash = HASH_STRING_STEP(hash, string[i]);
+    }
+
+    return hash;
+}
+
+static StringId* findslot(
+    StringPool* stringpool,
+    const char* string,
+    size_t      length,
+    Hash        hash
+)
+{
+    size_t mask = stringpool->indexcapacity - 1;
+    size_t position = (size_t)hash & mask;
+
+    // Probe linearly until the string or an empty slot is found (the index is
+    // never full so this always terminates)
+    for (;;)
+    {
+        StringId* slot = &stringpool->index[position];
+        if (*slot == STRINGPOOL_NO_ID)
+        {
+            return slot;
+        }
+
+        StringId id = *slot;
+        if (stringpool->hashes[id] == hash &&
+            stringpool->lengths[id] == length &&
+            memcmp(stringpool->strings[id], string, length) == 0)
+        {
+            return slot;
+        }
+
+        position = (position + 1) & mask;
+    }
+}
+
+static void reservestring(
+    StringPool* stringpool
+)
+{
+    assert(stringpool);
+
+    // Double the capacity of the arrays
+    size_t capacity = stringpool->capacity * 2;
+
+    const char** strings = (const char**)realloc((void*)stringpool->strings, sizeof(const char*) * capacity);
+    assert(strings);
+    stringpool->strings = strings;
+
+    Hash* hashes = (Hash*)realloc(stringpool->hashes, sizeof(Hash) * capacity);
+    assert(hashes);
+    stringpool->hashes = hashes;
+
+    size_t* lengths = (size_t*)realloc(stringpool->lengths, sizeof(size_t) * capacity);
+    assert(lengths);
+    stringpool->lengths = lengths;
+
+    uint8_t* flags = (uint8_t*)realloc(stringpool->flags, sizeof(uint8_t) * capacity);
+    assert(flags);
+    stringpool->flags = flags;
+
+    int32_t* refcounts = (int32_t*)realloc(stringpool->refcounts, sizeof(int32_t) * capacity);
+    assert(refcounts);
+    stringpool->refcounts = refcounts;
+
+    StringId* freeids = (StringId*)realloc(stringpool->freeids, sizeof(StringId) * capacity);
+    assert(freeids);
+    stringpool->freeids = freeids;
+
+    stringpool->capacity = capacity;
+
+    // Double the index to keep it at most half full
+    rebuildindex(stringpool, stringpool->indexcapacity * 2);
+}
+
+static void rebuildindex(
+    StringPool* stringpool,
+    size_t      indexcapacity
+)
+{
+    assert(stringpool);
+
+    StringId* index = (StringId*)malloc(sizeof(StringId) * indexcapacity);
+    assert(index);
+    memset(index, 0xFF, sizeof(StringId) * indexcapacity);
+
+    // Index each string using its remembered hash
+    size_t mask = indexcapacity - 1;
+    for (StringId id = 0; id < stringpool->nextid; ++id)
+    {
+        if (!stringpool->strings[id])
+        {
+            continue;
+        }
+
+        size_t position = (size_t)stringpool->hashes[id] & mask;
+        while (index[position] != STRINGPOOL_NO_ID)
+        {
+            position = (position + 1) & mask;
+        }
+        index[position] = id;
+    }
+
+    free(stringpool->index);
+    stringpool->index = index;
+    stringpool->indexcapacity = indexcapacity;
+}
+
+static void compactarena(
+    StringPool* stringpool
+)
+{
+    assert(stringpool);
+
+    Arena* arena = arena_new(STRINGPOOL_ARENA_CHUNK_SIZE);
+
+    for (StringId id = 0; id < stringpool->nextid; ++id)
+    {
+        const char* string = stringpool->strings[id];
+        if (string)
+        {
+            size_t size = stringpool->lengths[id] + 1;
+            char* newstring = (char*)arena_alloc(arena, size);
+            memcpy(newstring, string, size);
+            stringpool->strings[id] = newstring;
+        }
+    }
+
+    arena_free(stringpool->arena);
+    stringpool->arena = arena;
+    stringpool->arenabytes = stringpool->stringbytes;
+}
@@ -24,24 +24,46 @@
 #ifndef STRINGPOOL_H
 #define STRINGPOOL_H
 
+#include "arena.h"
 #include "hashtable.h"
 
 #include <string.h>
 
+#define STRINGPOOL_NO_ID    ((StringId)-1)
+
+// The flags of a string in a string pool
+#define STRINGPOOL_MARKED   (0x1)
+#define STRINGPOOL_PINNED   (0x2)
+
 // A numeric identifier for a string in a string pool
 typedef uint32_t StringId;
 
 // A pool of strings
+//
+// The bytes of the strings are stored in an arena and the arrays of strings,
+// hashes, and lengths grow as more strings are added.  The index maps the
+// hash of a string to its ID.  Strings which are not pinned, acquired, or
+// marked are collected by a sweep and their IDs are reused
 typedef struct StringPool
 {
-    HashTable*  hashtable;
-    char**      strings;
+    Arena*      arena;
+    const char** strings;
     Hash*       hashes;
-    size_t      stringcount;
+    size_t*     lengths;
+    uint8_t*    flags;
+    int32_t*    refcounts;
+    size_t      capacity;
+    StringId*   index;
+    size_t      indexcapacity;
+    StringId*   freeids;
+    size_t      freecount;
+    size_t      stringbytes;
+    size_t      arenabytes;
     StringId    nextid;
 } StringPool;
 
-// Creates a new string pool
+// Creates a new string pool with the initial capacity for the specified
+// number of strings
 StringPool* stringpool_new(
     size_t  stringcount
 );
@@ -66,6 +88,16 @@ StringId stringpool_getidsubstring(
     size_t      length
 );
 
+// Inserts a new substring or gets the ID of an existing string given the hash
+// of the substring (see HASH_STRING_STEP()), returning the ID associated with
+// the specified substring
+StringId stringpool_getidhashed(
+    StringPool* stringpool,
+    const char* string,
+    size_t      length,
+    Hash        hash
+);
+
 // Returns the string value from a string ID (NULL if no string exists of the
 // given ID)
 const char* stringpool_find(
@@ -79,4 +111,41 @@ Hash stringpool_hash(
     StringId    id
 );
 
+// Returns the length from a string ID
+size_t stringpool_length(
+    StringPool* stringpool,
+    StringId    id
+);
+
+// Pins a string so that it is never collected
+void stringpool_pin(
+    StringPool* stringpool,
+    StringId    id
+);
+
+// Acquires a reference to a string, assuring that it will not be collected
+// until after it is released
+void stringpool_acquire(
+    StringPool* stringpool,
+    StringId    id
+);
+
+// Releases a reference to a string
+void stringpool_release(
+    StringPool* stringpool,
+    StringId    id
+);
+
+// Marks a string to survive the next sweep
+void stringpool_mark(
+    StringPool* stringpool,
+    StringId    id
+);
+
+// Frees all strings which are not marked, pinned, or acquired, returning the
+// number of strings collected (pointers to the remaining strings may change)
+size_t stringpool_sweep(
+    StringPool* stringpool
+);
+
 #endif
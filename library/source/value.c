@@ -27,6 +27,7 @@
 #include "function.h"
 #include "heap.h"
 #include "state.h"
+#include "string.h"
 
 #include <assert.h>
 #include <math.h>
@@ -80,6 +81,16 @@ int c99_snprintf(
 
 #endif
 
+// Calls the operator overload of the left value's class, returning true if
+// the class overloads the operator or false otherwise
+static bool calloverload(
+    NomState*   state,
+    NomValue    selector,
+    NomValue    left,
+    NomValue    right,
+    NomValue*   result
+);
+
 NomValue nom_nil(
     void
 )
@@ -166,12 +177,7 @@ bool nom_equals(
     }
     else if (nom_isstring(state, left) && nom_isstring(state, right))
     {
-        // If one of the strings is not interned
-        if (GET_TYPE(left) != VALUETYPE_INTERNED_STRING ||
-                GET_TYPE(right) != VALUETYPE_INTERNED_STRING)
-        {
-            return strcmp(nom_getstring(state, left), nom_getstring(state, right)) == 0;
-        }
+        return string_equals(state, left, right);
     }
 
     return left.raw == right.raw;
@@ -192,14 +198,15 @@ long long nom_hash(
     case VALUETYPE_BOOLEAN:
         break;
     case VALUETYPE_INTERNED_STRING:
-        hash = stringpool_hash(state->stringpool, GET_ID(value));
+    case VALUETYPE_SMALL_STRING:
+        hash = string_gethash(state, value);
         break;
     case VALUETYPE_OBJECT:
     {
         HeapObject* object = heap_getobject(state->heap, value);
         if (object && object->type == OBJECTTYPE_STRING)
         {
-            hash = hashstring((UserData)nom_getstring(state, value), (UserData)state);
+            hash = string_gethash(state, value);
         }
     }
     break;
@@ -234,6 +241,14 @@ size_t nom_tostring(
     case VALUETYPE_INTERNED_STRING:
         count += snprintf(buffer, buffersize, "\"%s\"", nom_getstring(state, value));
         break;
+    case VALUETYPE_SMALL_STRING:
+    {
+        char smallbuffer[SMALL_STRING_MAX_LENGTH];
+        size_t length;
+        const char* string = string_getspan(state, value, smallbuffer, &length);
+        count += snprintf(buffer, buffersize, "\"%.*s\"", (int)length, string);
+    }
+    break;
     case VALUETYPE_OBJECT:
     {
         HeapObject* object = heap_getobject(state->heap, value);
@@ -316,6 +331,13 @@ size_t nom_tostring(
             case OBJECTTYPE_FUNCTION:
                 count += snprintf(buffer, buffersize, "<function with ID 0x%08x>", GET_ID(value));
                 break;
+            case OBJECTTYPE_BYTES:
+            {
+                size_t length = 0;
+                nom_getbytes(state, value, &length);
+                count += snprintf(buffer, buffersize, "<bytes with ID 0x%08x and length %u>", GET_ID(value), (unsigned)length);
+            }
+            break;
             default:
                 count += snprintf(buffer, buffersize, "<unknown>");
                 break;
@@ -339,17 +361,13 @@ NomValue nom_add(
 {
     NomValue result = nom_nil();
 
-    if (!IS_NUMBER(left) || !IS_NUMBER(right))
+    if (nom_isstring(state, left) && nom_isstring(state, right))
     {
-        NomValue class = map_getclass(state, left);
-        NomValue function;
-        if (nom_find(state, class, state->strings.add, &function) &&
-                nom_isfunction(state, function))
-        {
-            NomValue args[2] = { { left.raw }, { right.raw } };
-            result = nom_call(state, function, 2, args);
-        }
-        else
+        result = string_concat(state, left, right);
+    }
+    else if (!IS_NUMBER(left) || !IS_NUMBER(right))
+    {
+        if (!calloverload(state, state->strings.add, left, right, &result))
         {
             nom_seterror(state, "Cannot add non-numeric values");
         }
@@ -372,15 +390,7 @@ NomValue nom_sub(
 
     if (!IS_NUMBER(left) || !IS_NUMBER(right))
     {
-        NomValue class = map_getclass(state, left);
-        NomValue function;
-        if (nom_find(state, class, state->strings.subtract, &function) &&
-                nom_isfunction(state, function))
-        {
-            NomValue args[2] = { { left.raw }, { right.raw } };
-            result = nom_call(state, function, 2, args);
-        }
-        else
+        if (!calloverload(state, state->strings.subtract, left, right, &result))
         {
             nom_seterror(state, "Cannot subtract non-numeric values");
         }
@@ -403,15 +413,7 @@ NomValue nom_mul(
 
     if (!IS_NUMBER(left) || !IS_NUMBER(right))
     {
-        NomValue class = map_getclass(state, left);
-        NomValue function;
-        if (nom_find(state, class, state->strings.multiply, &function) &&
-                nom_isfunction(state, function))
-        {
-            NomValue args[2] = { { left.raw }, { right.raw } };
-            result = nom_call(state, function, 2, args);
-        }
-        else
+        if (!calloverload(state, state->strings.multiply, left, right, &result))
         {
             nom_seterror(state, "Cannot multiply non-numeric values");
         }
@@ -434,15 +436,7 @@ NomValue nom_div(
 
     if (!IS_NUMBER(left) || !IS_NUMBER(right))
     {
-        NomValue class = map_getclass(state, left);
-        NomValue function;
-        if (nom_find(state, class, state->strings.divide, &function) &&
-                nom_isfunction(state, function))
-        {
-            NomValue args[2] = { { left.raw }, { right.raw } };
-            result = nom_call(state, function, 2, args);
-        }
-        else
+        if (!calloverload(state, state->strings.divide, left, right, &result))
         {
             nom_seterror(state, "Cannot divide non-numeric values");
         }
@@ -546,6 +540,20 @@ bool nom_insert(
     return result;
 }
 
+bool nom_remove(
+    NomState*   state,
+    NomValue    value,
+    NomValue    key
+)
+{
+    bool result = false;
+    if (nom_ismap(state, value))
+    {
+        result = map_remove(state, value, key);
+    }
+    return result;
+}
+
 bool nom_update(
     NomState*   state,
     NomValue    value,
@@ -618,10 +626,17 @@ void nom_acquire(
 {
     assert(state);
 
-    HeapObject* object = heap_getobject(state->heap, value);
-    if (object)
+    if (GET_TYPE(value) == VALUETYPE_INTERNED_STRING)
+    {
+        stringpool_acquire(state->stringpool, GET_ID(value));
+    }
+    else
     {
-        ++object->refcount;
+        HeapObject* object = heap_getobject(state->heap, value);
+        if (object)
+        {
+            ++object->refcount;
+        }
     }
 }
 
@@ -632,10 +647,17 @@ void nom_release(
 {
     assert(state);
 
-    HeapObject* object = heap_getobject(state->heap, value);
-    if (object)
+    if (GET_TYPE(value) == VALUETYPE_INTERNED_STRING)
     {
-        --object->refcount;
+        stringpool_release(state->stringpool, GET_ID(value));
+    }
+    else
+    {
+        HeapObject* object = heap_getobject(state->heap, value);
+        if (object)
+        {
+            --object->refcount;
+        }
     }
 }
 
@@ -664,4 +686,34 @@ void value_visit(
     {
         function_visit_scope(state, value, visitor);
     }
+    else if (nom_isstring(state, value))
+    {
+        string_visit(state, value, visitor);
+    }
+}
+
+static bool calloverload(
+    NomState*   state,
+    NomValue    selector,
+    NomValue    left,
+    NomValue    right,
+    NomValue*   result
+)
+{
+    assert(state);
+    assert(result);
+
+    bool found = false;
+
+    NomValue class = map_getclass(state, left);
+    NomValue function;
+    if (state_findmethod(state, class, GET_ID(selector), &function) &&
+            nom_isfunction(state, function))
+    {
+        NomValue args[2] = { { left.raw }, { right.raw } };
+        *result = state_call(state, function, 2, args);
+        found = true;
+    }
+
+    return found;
 }
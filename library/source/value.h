@@ -33,7 +33,8 @@ typedef enum
     VALUETYPE_NUMBER,
     VALUETYPE_BOOLEAN,
     VALUETYPE_INTERNED_STRING,
-    VALUETYPE_OBJECT
+    VALUETYPE_OBJECT,
+    VALUETYPE_SMALL_STRING
 } ValueType;
 
 // Enumeration of each type an object can be
@@ -42,6 +43,7 @@ typedef enum
     OBJECTTYPE_STRING,
     OBJECTTYPE_MAP,
     OBJECTTYPE_FUNCTION,
+    OBJECTTYPE_BYTES,
 } ObjectType;
 
 #define TYPE_MASK       (0x0000000000000007)
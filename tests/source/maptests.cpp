@@ -284,6 +284,37 @@ TEST_CASE("Iterating over a map", "[Map]")
     nom_freestate(state);
 }
 
+TEST_CASE("Iterating over a map in insertion order after it grows", "[Map]")
+{
+    NomState* state = nom_newstate();
+
+    NomValue map = nom_newmap(state);
+
+    // Insert enough keys in descending order to grow the map several times
+    for (int i = 0; i < 100; ++i)
+    {
+        CHECK(nom_insert(state, map, nom_fromint(100 - i), nom_fromint(i)) == true);
+    }
+
+    int i = 0;
+    NomIterator iterator = { 0 };
+    while (nom_next(state, map, &iterator))
+    {
+        CHECK(nom_equals(state, iterator.key, nom_fromint(100 - i)) == true);
+        CHECK(nom_equals(state, iterator.value, nom_fromint(i)) == true);
+        ++i;
+    }
+    CHECK(i == 100);
+
+    for (int i = 0; i < 100; ++i)
+    {
+        NomValue result = nom_get(state, map, nom_fromint(100 - i));
+        CHECK(nom_equals(state, result, nom_fromint(i)) == true);
+    }
+
+    nom_freestate(state);
+}
+
 TEST_CASE("Creating a map with implicit keys", "[Map]")
 {
     NomState* state = nom_newstate();
@@ -334,3 +365,109 @@ TEST_CASE("Indexing maps", "[Map]")
 
     nom_freestate(state);
 }
+
+TEST_CASE("Removing keys from a map", "[Map]")
+{
+    NomState* state = nom_newstate();
+
+    NomValue map = nom_evaluate(state, "{ a := 1, b := 2, c := 3 }");
+    CHECK(nom_error(state) == false);
+
+    CHECK(nom_remove(state, map, nom_newstring(state, "b")) == true);
+    CHECK(nom_remove(state, map, nom_newstring(state, "b")) == false);
+    CHECK(nom_remove(state, nom_fromint(1), nom_newstring(state, "a")) == false);
+
+    NomValue result;
+    CHECK(nom_find(state, map, nom_newstring(state, "b"), &result) == false);
+    result = nom_get(state, map, nom_newstring(state, "a"));
+    CHECK(nom_equals(state, result, nom_fromint(1)) == true);
+    result = nom_get(state, map, nom_newstring(state, "c"));
+    CHECK(nom_equals(state, result, nom_fromint(3)) == true);
+
+    // A removed key can be inserted again
+    CHECK(nom_insert(state, map, nom_newstring(state, "b"), nom_fromint(4)) == true);
+    result = nom_get(state, map, nom_newstring(state, "b"));
+    CHECK(nom_equals(state, result, nom_fromint(4)) == true);
+
+    nom_freestate(state);
+}
+
+TEST_CASE("Iterating over a map in insertion order after removing keys", "[Map]")
+{
+    NomState* state = nom_newstate();
+
+    NomValue map = nom_newmap(state);
+    nom_acquire(state, map);
+
+    // Remove most keys while inserting so that the entries are compacted
+    for (int i = 0; i < 100; ++i)
+    {
+        CHECK(nom_insert(state, map, nom_fromint(i), nom_fromint(i * 2)) == true);
+        if (i > 0 && (i - 1) % 4 != 0)
+        {
+            CHECK(nom_remove(state, map, nom_fromint(i - 1)) == true);
+        }
+    }
+
+    int expected = 0;
+    NomIterator iterator = { 0 };
+    while (nom_next(state, map, &iterator))
+    {
+        CHECK(nom_equals(state, iterator.key, nom_fromint(expected)) == true);
+        CHECK(nom_equals(state, iterator.value, nom_fromint(expected * 2)) == true);
+        expected += (expected == 96) ? 3 : 4;
+    }
+    CHECK(expected == 103);
+
+    for (int i = 0; i < 100; ++i)
+    {
+        NomValue result;
+        bool found = i % 4 == 0 || i == 99;
+        CHECK(nom_find(state, map, nom_fromint(i), &result) == found);
+    }
+
+    nom_release(state, map);
+    nom_freestate(state);
+}
+
+TEST_CASE("Finding keys from a script using strings created by the host", "[Map]")
+{
+    NomState* state = nom_newstate();
+
+    // The hashes computed by the lexer must match hashes of other strings
+    NomValue map = nom_evaluate(state, "{ plain := 1, \"na\xC3\xAFve\" -> 2 }");
+    CHECK(nom_error(state) == false);
+
+    NomValue result;
+    result = nom_get(state, map, nom_newstring(state, "plain"));
+    CHECK(nom_equals(state, result, nom_fromint(1)) == true);
+    result = nom_get(state, map, nom_newstring(state, "na\xC3\xAFve"));
+    CHECK(nom_equals(state, result, nom_fromint(2)) == true);
+    result = nom_get(state, map, nom_newinternedstring(state, "na\xC3\xAFve"));
+    CHECK(nom_equals(state, result, nom_fromint(2)) == true);
+
+    nom_freestate(state);
+}
+
+TEST_CASE("Using strings created by the host as keys", "[Map]")
+{
+    NomState* state = nom_newstate();
+
+    NomValue map = nom_newmap(state);
+    CHECK(nom_insert(state, map, nom_newstring(state, "abc"), nom_fromint(1)) == true);
+    CHECK(nom_insert(state, map, nom_newstring(state, "abd"), nom_fromint(2)) == true);
+    CHECK(nom_insert(state, map, nom_newstring(state, "abcd"), nom_fromint(3)) == true);
+    CHECK(nom_insert(state, map, nom_newinternedstring(state, "abc"), nom_fromint(4)) == false);
+
+    CHECK(nom_equals(state, nom_newstring(state, "abc"), nom_newinternedstring(state, "abc")) == true);
+    CHECK(nom_equals(state, nom_newstring(state, "abc"), nom_newstring(state, "abd")) == false);
+    CHECK(nom_equals(state, nom_newstring(state, "abc"), nom_newstring(state, "abcd")) == false);
+
+    NomValue result;
+    result = nom_get(state, map, nom_newstring(state, "abd"));
+    CHECK(nom_equals(state, result, nom_fromint(2)) == true);
+    result = nom_get(state, map, nom_newinternedstring(state, "abcd"));
+    CHECK(nom_equals(state, result, nom_fromint(3)) == true);
+
+    nom_freestate(state);
+}
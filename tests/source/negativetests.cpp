@@ -40,3 +40,4 @@ extern "C"
 
 TEST_FILE("tests/negative/call_uncallable.ns", "Value cannot be called")
 TEST_FILE("tests/negative/too_many_arguments.ns", "Too many arguments given (expected 3)")
+TEST_FILE("tests/negative/undefined_variable.ns", "No variable 'missing' in scope")
@@ -23,6 +23,8 @@
 ///////////////////////////////////////////////////////////////////////////////
 #include <catch.hpp>
 
+#include <cstdlib>
+
 extern "C"
 {
 #include <nominal.h>
@@ -245,3 +247,42 @@ TEST_CASE("Calling nom_isiterable() a Nominal number", "[Number]")
 
     nom_freestate(state);
 }
+
+TEST_CASE("Evaluating number literals", "[Number]")
+{
+    NomState* state = nom_newstate();
+
+    const char* literals[] =
+    {
+        "0",
+        "7",
+        "4096",
+        "007",
+        "0.5",
+        "0.1",
+        "3.14159",
+        "1.",
+        "2.50000",
+        "9007199254740992",
+        "9007199254740993",
+        "18446744073709551615",
+        "123456789012345678901234567890",
+        "0.1234567890123456789",
+        "0.0000000000000000000000001",
+        "179769313486231570000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000.0",
+        "2.2250738585072014"
+    };
+
+    for (size_t i = 0; i < sizeof(literals) / sizeof(literals[0]); ++i)
+    {
+        const char* literal = literals[i];
+        NomValue value = nom_evaluate(state, literal);
+        CHECK(!nom_error(state));
+        CHECK(nom_todouble(value) == strtod(literal, NULL));
+    }
+
+    NomValue value = nom_evaluate(state, "1.5+2.25");
+    CHECK(nom_todouble(value) == 3.75);
+
+    nom_freestate(state);
+}
@@ -52,16 +52,26 @@ TEST_FILE("tests/positive/class_creation.ns")
 TEST_FILE("tests/positive/class_get_and_set.ns")
 TEST_FILE("tests/positive/comments.ns")
 TEST_FILE("tests/positive/comparison_operators.ns")
+TEST_FILE("tests/positive/constant_folding.ns")
+TEST_FILE("tests/positive/evaluation_order.ns")
 TEST_FILE("tests/positive/fibonacci.ns")
 TEST_FILE("tests/positive/functions.ns")
 TEST_FILE("tests/positive/get_intrinsic_class.ns")
 TEST_FILE("tests/positive/if.ns")
 TEST_FILE("tests/positive/import.ns")
+TEST_FILE("tests/positive/inline_cache.ns")
+TEST_FILE("tests/positive/inlining.ns")
 TEST_FILE("tests/positive/map.ns")
+TEST_FILE("tests/positive/map_remove.ns")
+TEST_FILE("tests/positive/method_cache.ns")
 TEST_FILE("tests/positive/objects.ns")
 TEST_FILE("tests/positive/object_constructors.ns")
 TEST_FILE("tests/positive/overload_arithmetic.ns")
+TEST_FILE("tests/positive/quickening.ns")
 TEST_FILE("tests/positive/short_circuit_and.ns")
+TEST_FILE("tests/positive/short_circuit_chains.ns")
 TEST_FILE("tests/positive/short_circuit_or.ns")
+TEST_FILE("tests/positive/string_concat.ns")
+TEST_FILE("tests/positive/string_views.ns")
 TEST_FILE("tests/positive/to_string.ns")
 TEST_FILE("tests/positive/while.ns")
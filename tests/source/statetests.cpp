@@ -23,6 +23,9 @@
 ///////////////////////////////////////////////////////////////////////////////
 #include <catch.hpp>
 
+#include <cstdio>
+#include <cstring>
+
 extern "C"
 {
 #include <nominal.h>
@@ -109,7 +112,7 @@ TEST_CASE("Collecting garbage when there are no unreferenced objects", "[State]"
     NomState* state = nom_newstate();
     CHECK(state);
 
-    nom_letvar(state, "x", nom_newstring(state, "Test"));
+    nom_letvar(state, "x", nom_newstring(state, "Test string"));
     CHECK(!nom_error(state));
 
     CHECK(nom_collectgarbage(state) == 0);
@@ -122,7 +125,7 @@ TEST_CASE("Collecting garbage when there are unreferenced objects", "[State]")
     NomState* state = nom_newstate();
     CHECK(state);
 
-    nom_letvar(state, "x", nom_newstring(state, "Test"));
+    nom_letvar(state, "x", nom_newstring(state, "Test string"));
     CHECK(!nom_error(state));
 
     nom_setvar(state, "x", nom_nil());
@@ -132,3 +135,256 @@ TEST_CASE("Collecting garbage when there are unreferenced objects", "[State]")
 
     nom_freestate(state);
 }
+
+TEST_CASE("Defining many distinct variables", "[State]")
+{
+    NomState* state = nom_newstate();
+
+    // More distinct names than the initial capacity of the string pool
+    char name[32];
+    for (int i = 0; i < 5000; ++i)
+    {
+        snprintf(name, sizeof(name), "variable_%d", i);
+        nom_letvar(state, name, nom_fromint(i));
+        CHECK(!nom_error(state));
+    }
+
+    for (int i = 0; i < 5000; ++i)
+    {
+        snprintf(name, sizeof(name), "variable_%d", i);
+        NomValue value = nom_getvar(state, name);
+        CHECK(nom_equals(state, value, nom_fromint(i)));
+    }
+
+    nom_freestate(state);
+}
+
+TEST_CASE("Evaluating many distinct constants", "[State]")
+{
+    NomState* state = nom_newstate();
+
+    // More distinct constants than the initial capacity of the constant pool
+    char source[64];
+    nom_execute(state, "c := nil");
+    for (int i = 0; i < 500; ++i)
+    {
+        snprintf(source, sizeof(source), "c = %d", i);
+        nom_evaluate(state, source);
+        REQUIRE(!nom_error(state));
+
+        snprintf(source, sizeof(source), "c + %d", i + 1000);
+        NomValue value = nom_evaluate(state, source);
+        CHECK(nom_equals(state, value, nom_fromint(2 * i + 1000)));
+    }
+
+    nom_freestate(state);
+}
+
+TEST_CASE("Collecting garbage when there are unreferenced interned strings", "[State]")
+{
+    NomState* state = nom_newstate();
+    CHECK(state);
+
+    CHECK(nom_collectgarbage(state) == 0);
+
+    char string[32];
+    for (int i = 0; i < 1000; ++i)
+    {
+        snprintf(string, sizeof(string), "unreferenced_%d", i);
+        nom_newinternedstring(state, string);
+    }
+
+    NomValue acquired = nom_newinternedstring(state, "acquired");
+    nom_acquire(state, acquired);
+
+    NomValue map = nom_newmap(state);
+    nom_insert(state, map, nom_newinternedstring(state, "key"), nom_newinternedstring(state, "value"));
+    nom_letvar(state, "map", map);
+    CHECK(!nom_error(state));
+
+    CHECK(nom_collectgarbage(state) == 1000);
+
+    // Strings created after the collection reuse the collected IDs
+    for (int i = 0; i < 1000; ++i)
+    {
+        snprintf(string, sizeof(string), "new_%d", i);
+        nom_newinternedstring(state, string);
+    }
+
+    CHECK(strcmp(nom_getstring(state, acquired), "acquired") == 0);
+
+    NomValue value = nom_get(state, map, nom_newinternedstring(state, "key"));
+    CHECK(nom_isstring(state, value));
+    CHECK(strcmp(nom_getstring(state, value), "value") == 0);
+
+    nom_release(state, acquired);
+    CHECK(nom_collectgarbage(state) == 1001);
+
+    nom_freestate(state);
+}
+
+TEST_CASE("Collecting garbage does not collect strings used by compiled code", "[State]")
+{
+    NomState* state = nom_newstate();
+    CHECK(state);
+
+    nom_execute(state, "get_name := [ \"a name\" ]");
+    CHECK(!nom_error(state));
+
+    CHECK(nom_collectgarbage(state) == 0);
+
+    NomValue value = nom_evaluate(state, "get_name:");
+    CHECK(!nom_error(state));
+    CHECK(strcmp(nom_getstring(state, value), "a name") == 0);
+
+    nom_freestate(state);
+}
+
+TEST_CASE("Appending to a string many times", "[State]")
+{
+    NomState* state = nom_newstate();
+    CHECK(state);
+
+    nom_execute(state, "s := \"\", i := 0, while: [ i < 100000 ] [ s = s + \"ab\", i = i + 1 ]");
+    CHECK(!nom_error(state));
+
+    // The rope is traced without recursing down its length, so once the
+    // garbage of the loop is collected a second collection finds nothing
+    nom_collectgarbage(state);
+    CHECK(nom_collectgarbage(state) == 0);
+
+    // The rope is flattened intact after the collections
+    const char* string = nom_getstring(state, nom_getvar(state, "s"));
+    REQUIRE(string);
+    REQUIRE(strlen(string) == 200000);
+
+    bool intact = true;
+    for (size_t i = 0; i < 200000; ++i)
+    {
+        intact = intact && string[i] == (i % 2 == 0 ? 'a' : 'b');
+    }
+    CHECK(intact);
+
+    // Once no longer referenced the nodes of the rope are collected
+    nom_execute(state, "s = nil");
+    CHECK(nom_collectgarbage(state) > 0);
+
+    nom_freestate(state);
+}
+
+TEST_CASE("Creating short strings", "[State]")
+{
+    NomState* state = nom_newstate();
+    CHECK(state);
+
+    // Short strings are packed in the value instead of allocated on the heap
+    NomValue empty = nom_newstring(state, "");
+    NomValue abcd = nom_newstring(state, "abcd");
+    CHECK(nom_collectgarbage(state) == 0);
+
+    CHECK(nom_isstring(state, empty));
+    CHECK(nom_isstring(state, abcd));
+    CHECK(strcmp(nom_getstring(state, empty), "") == 0);
+    CHECK(strcmp(nom_getstring(state, abcd), "abcd") == 0);
+
+    CHECK(nom_equals(state, abcd, nom_newstring(state, "abcd")));
+    CHECK(nom_equals(state, abcd, nom_newinternedstring(state, "abcd")));
+    CHECK(!nom_equals(state, abcd, nom_newstring(state, "abc")));
+    CHECK(nom_hash(state, abcd) == nom_hash(state, nom_newinternedstring(state, "abcd")));
+
+    char buffer[32];
+    nom_tostring(state, buffer, sizeof(buffer), abcd);
+    CHECK(strcmp(buffer, "\"abcd\"") == 0);
+
+    nom_freestate(state);
+}
+
+static int releasecount = 0;
+
+static void countrelease(void* data)
+{
+    (void)data;
+    ++releasecount;
+}
+
+TEST_CASE("Creating strings referencing host memory", "[State]")
+{
+    NomState* state = nom_newstate();
+    CHECK(state);
+
+    releasecount = 0;
+
+    // The string does not need to be NULL-terminated
+    const char buffer[] = { 'h', 'e', 'l', 'l', 'o', '!', '!' };
+    NomValue string = nom_newexternalstring(state, buffer, 5, countrelease);
+    CHECK(nom_isstring(state, string));
+    CHECK(nom_equals(state, string, nom_newstring(state, "hello")));
+
+    nom_letvar(state, "s", string);
+    NomValue result = nom_evaluate(state, "s + \" world\"");
+    CHECK(!nom_error(state));
+    CHECK(strcmp(nom_getstring(state, result), "hello world") == 0);
+
+    nom_setvar(state, "s", nom_nil());
+    nom_collectgarbage(state);
+    CHECK(releasecount == 1);
+
+    // Getting a NULL-terminated string copies and releases the host's string
+    string = nom_newexternalstring(state, buffer, 6, countrelease);
+    CHECK(strcmp(nom_getstring(state, string), "hello!") == 0);
+    CHECK(releasecount == 2);
+
+    nom_freestate(state);
+}
+
+TEST_CASE("Creating byte buffers referencing host memory", "[State]")
+{
+    NomState* state = nom_newstate();
+    CHECK(state);
+
+    releasecount = 0;
+
+    const unsigned char data[] = { 0, 1, 2, 3, 255 };
+    NomValue bytes = nom_newbytes(state, data, sizeof(data), countrelease);
+    CHECK(nom_isbytes(state, bytes));
+    CHECK(!nom_isstring(state, bytes));
+
+    size_t length = 0;
+    CHECK(nom_getbytes(state, bytes, &length) == data);
+    CHECK(length == sizeof(data));
+
+    nom_letvar(state, "b", bytes);
+    NomValue result = nom_evaluate(state, "class_of: b");
+    CHECK(nom_equals(state, result, nom_getvar(state, "Bytes")));
+
+    nom_setvar(state, "b", nom_nil());
+    nom_collectgarbage(state);
+    CHECK(releasecount == 1);
+
+    nom_freestate(state);
+}
+
+TEST_CASE("Lexing long tokens, comments and whitespace", "[State]")
+{
+    NomState* state = nom_newstate();
+    CHECK(state);
+
+    const char* source =
+        "a_long_identifier_name_with_digits_0123456789_and_more := \"\n"
+        "a string spanning two lines which is longer than a block\"\n"
+        "{- a multi-line comment which is longer than a block - with dashes\n"
+        "   and spans - over - multiple lines -}\n"
+        "                                                  \n"
+        "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\n"
+        "-- a single-line comment which is longer than a block of characters\n"
+        "a_long_identifier_name_with_digits_0123456789_and_more";
+
+    NomValue value = nom_evaluate(state, source);
+    CHECK(!nom_error(state));
+    CHECK(std::string(nom_getstring(state, value)) == "\na string spanning two lines which is longer than a block");
+
+    nom_evaluate(state, "\n\n-- a single-line comment which is longer than a block of characters\n{- a multi-line comment \n which is longer than a block -}\n\"a\nstring\" := )");
+    CHECK(std::string(nom_geterror(state)).find("on line 7") != std::string::npos);
+
+    nom_freestate(state);
+}
@@ -0,0 +1,31 @@
+# Sums the opcode pair histograms of several Nominal scripts
+#
+# Usage: python opcodepairs.py <nominal executable> <script...>
+#
+# The executable must be built with NOM_OPCODE_PROFILE enabled.
+
+import re
+import sys
+from subprocess import Popen, PIPE
+
+if len(sys.argv) < 3:
+    print("Usage: python opcodepairs.py <nominal executable> <script...>")
+    sys.exit(1)
+
+executable = sys.argv[1]
+pattern = re.compile(r"^\s*(\d+)\s+[\d.]+%\s+(\w+) (\w+)$")
+
+counts = {}
+for script in sys.argv[2:]:
+    process = Popen([executable, "-p", script], stdout=PIPE, universal_newlines=True)
+    output, _ = process.communicate()
+    for line in output.splitlines():
+        match = pattern.match(line)
+        if match:
+            pair = (match.group(2), match.group(3))
+            counts[pair] = counts.get(pair, 0) + int(match.group(1))
+
+total = sum(counts.values())
+print("Opcode pairs (%d executed):" % total)
+for pair, count in sorted(counts.items(), key=lambda item: -item[1]):
+    print("%12d %6.2f%%  %s %s" % (count, 100.0 * count / total, pair[0], pair[1]))